@@ -4,6 +4,40 @@ import matplotlib.pyplot as plt
 import pandas as pd
 from pandasql import sqldf
 import numpy as np
+import sys
+
+def plot_benchmark(path):
+    """Plots a CSV of test/benchmark.cc: time per element (median with the
+    95% confidence interval) per distribution, one figure per type, thread
+    count and array size."""
+    df = pd.read_csv(path)
+    for (typ, threads, size), group in df.groupby(['type', 'threads', 'vectorsize']):
+        distributions = list(dict.fromkeys(group['distribution']))
+        algorithms = list(dict.fromkeys(group['algorithm']))
+        x = np.arange(len(distributions))
+        width = 0.8 / len(algorithms)
+        fig, ax = plt.subplots()
+        for i, algorithm in enumerate(algorithms):
+            rows = group[group['algorithm'] == algorithm].set_index('distribution').reindex(distributions)
+            median = rows['median'].to_numpy() / size * 1e9
+            low = median - rows['ci_low'].to_numpy() / size * 1e9
+            high = rows['ci_high'].to_numpy() / size * 1e9 - median
+            ax.bar(x + (i - len(algorithms) / 2 + 0.5) * width, median, width,
+                   yerr=[low, high], capsize=2, label=algorithm)
+        ax.set_ylabel('time per element [ns]')
+        ax.set_title('{}, {} threads, {} elements'.format(typ, threads, size))
+        ax.set_xticks(x)
+        ax.set_xticklabels(distributions, rotation=30, ha='right')
+        ax.spines['right'].set_color("none")
+        ax.spines['top'].set_color("none")
+        ax.legend(fontsize='small')
+        fig.tight_layout()
+    plt.show()
+
+# graphs.py benchmark.csv plots the output of test/benchmark.cc
+if len(sys.argv) > 1:
+    plot_benchmark(sys.argv[1])
+    sys.exit(0)
 
 def autolabel(rects):
     """Attach a text label above each bar in *rects*, displaying its height."""
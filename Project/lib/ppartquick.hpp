@@ -3,622 +3,5646 @@
 
 #include <omp.h>
 #include <atomic>
-// defines block size
-// Please adopt this variable when using the library
-// it depands on used data type and the sysemts L1-cache
+#include <algorithm>
+#include <iterator>
+#include <functional>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <type_traits>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <future>
+#include <stdexcept>
+#include <utility>
+#include <tuple>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
+#include <cstddef>
+#if defined( __AVX2__ ) || defined( __AVX512F__ )
+#include <immintrin.h>
+#endif
+#if defined( __unix__ )
+#include <unistd.h>
+#endif
+#if defined( __linux__ )
+#include <sched.h>
+#endif
+#if defined( PPQ_STD_EXECUTION )
+#include <execution>
+#endif
+
+// block size policy
 // two blocks should fit in L1-Cache:
 // Size(DType) * B * 2 = L1-Cache
 // Using simultaneous multi-threading / hyperthreading:
 // Size(DType) * B * 2 * 2 = L1-Cache
-#define B 2096
-
-// receives two blocks and obtains one left-side or one right-side block or both
-// returns 1 for a left-side, 2 for a right.side block, and 3 for both
-template< class FwdIt, class Predicate >
-inline constexpr int neutralize( const FwdIt left_first, const FwdIt left_last,
-                                 const FwdIt right_first, const FwdIt right_last,
-                                 const Predicate pred )
-{
-  auto left_it = left_first;
-  auto right_it = right_first;
-  while( left_it <= left_last && right_it <= right_last)
-  {
-    for( ; left_it < left_last; left_it++ )
-      if( !pred(*left_it) ) break;
-
-    for( ; right_it < right_last; right_it++ )
-      if( pred(*right_it) ) break;
-
-    if( (left_it == left_last) || (right_it == right_last) ) break;
+// ppartition, quicksort, pquickselect, ... take the block size as first
+// template parameter, e.g. ppartition< 4096 >( first, last, pred )
+// BlockSize = 0 (default) derives the block size from sizeof(value_type),
+// the detected L1d-cache size and whether SMT is active
 
-    auto tmp = *left_it;
-    *left_it = *right_it;
-    *right_it = tmp;
+// assumed L1d-cache size in bytes if it cannot be detected
+constexpr long default_l1d_cache_size = 32768;
+// smallest block size handed out by the policy
+constexpr long min_block_size = 16;
 
-    ++left_it; ++right_it;
-  }
-
-  if( (left_it == left_last) && (right_it == right_last) ) return 2;
-  if( left_it == left_last ) return 0;
-  return 1;
+// reads a cache size like "48K" from sysfs, returns 0 on failure
+inline long read_sysfs_cache_size( const char *path )
+{
+  std::ifstream file( path );
+  long size = 0;
+  std::string unit;
+  if( !(file >> size) ) return 0;
+  file >> unit;
+  if( !unit.empty() && (unit[0] == 'K' || unit[0] == 'k') ) size *= 1024;
+  if( !unit.empty() && (unit[0] == 'M' || unit[0] == 'm') ) size *= 1024 * 1024;
+  return size;
 }
 
-// extracts block from the left side of the array
-template< class FwdIt >
-inline void getLeftBlock( const FwdIt first, const FwdIt last,
-                          FwdIt &left_first, FwdIt &left_last,
-                          std::atomic<int> &numRemainingBlocks, std::atomic<int> &i )
+// detects the size of the L1d-cache of one core in bytes
+// sysconf is tried first, then sysfs, then the default is assumed
+inline long detect_l1d_cache_size()
 {
-  if( 0 < std::atomic_fetch_sub( &numRemainingBlocks, 1 ) )
-  {
-    auto ii = std::atomic_fetch_add( &i, 1 );
-    left_first = first + ii*B;
-    left_last = first + ii*B + B;
-  }
-  else
-  {
-    left_first = last;
-    left_last = last;
-  }
+#if defined( _SC_LEVEL1_DCACHE_SIZE )
+  const long size = sysconf( _SC_LEVEL1_DCACHE_SIZE );
+  if( size > 0 ) return size;
+#endif
+  const long sysfs_size =
+    read_sysfs_cache_size( "/sys/devices/system/cpu/cpu0/cache/index0/size" );
+  if( sysfs_size > 0 ) return sysfs_size;
+  return default_l1d_cache_size;
 }
 
-// extracts block from the right side of the array
-template< class FwdIt >
-inline void getRightBlock( const FwdIt first, const FwdIt last,
-                           FwdIt &right_first, FwdIt &right_last,
-                           std::atomic<int> &numRemainingBlocks, std::atomic<int> &j,
-                           const long N )
+// detects whether simultaneous multi-threading / hyperthreading is active
+// in that case two threads share the L1d-cache of a core
+inline bool detect_smt()
 {
-  if( 0 < std::atomic_fetch_sub( &numRemainingBlocks, 1 ) )
-  {
-    auto jj = std::atomic_fetch_add( &j, 1 );
-    right_first = last - N%B - jj*B;
-    right_last = last - N%B - jj*B + B;
-  }
-  else
-  {
-    right_first = last;
-    right_last = last;
-  }
+  std::ifstream file( "/sys/devices/system/cpu/smt/active" );
+  int active = 0;
+  if( file >> active ) return active != 0;
+  return false;
 }
 
-// all processors partition the array blockwise
-// first, last = array borders
-// num = number of threads
-// LN, RN = partitioned left/right-side elements
-// p = number of remaining Blocks after parallel phase
-// remainingBlocks = remembers first element-index of all remaining blocks
-template< class FwdIt, class Predicate >
-inline void parallel_phase( const FwdIt first, const FwdIt last,
-                            const Predicate pred, const int num,
-                            long &LN, long &RN, int &p, long *remainingBlocks )
+// number of elements per block for elements of size elem_size
+constexpr long block_size_for( const long elem_size, const long l1d_size,
+                               const bool smt )
 {
-  const long N = last - first;
-  LN = 0;
-  RN = 0;
-  p = 0;
-  // variables for assigning threads
-  std::atomic<int> numRemainingBlocks( (N-1) / B + 1 );
-  std::atomic<int> i( 0 );
-  std::atomic<int> j( 0 );
-  if (N%B == 0) j++;
+  const long size = l1d_size / ( elem_size * 2 * (smt ? 2 : 1) );
+  return size < min_block_size ? min_block_size : size;
+}
 
-  for( int tid = 0; tid < num; ++tid )
-  {
-#pragma omp task firstprivate( tid ) shared( LN, RN, p, i, j, numRemainingBlocks ) if( num > 1 )
+// returns the block size used for elements of type T
+// a BlockSize other than 0 is used as given
+template< long BlockSize, class T >
+inline long block_size()
 {
-    FwdIt left_first, left_last, right_first, right_last;
-    long LN_ = 0;
-    long RN_ = 0;
-    int p_ = 0;
-
-    getLeftBlock( first, last, left_first, left_last, numRemainingBlocks, i );
-    getRightBlock( first, last, right_first, right_last, numRemainingBlocks, j, N );
-    if( right_last > last ) right_last = last;
-
-    while( (left_first != last) && (right_first != last) )
-    {
-      auto result = neutralize( left_first, left_last, right_first, right_last, pred );
-      if( result%2 == 0 ) // left-side block was obtained
-      {
-        LN_ += left_last-left_first;
-        getLeftBlock( first, last, left_first, left_last, numRemainingBlocks, i );
-      }
-      if( result > 0 ) // right-side block was obtained
-      {
-        RN_ += right_last - right_first;
-        getRightBlock( first, last, right_first, right_last, numRemainingBlocks, j, N );
-      }
-    }
-    remainingBlocks[tid] = last - first;
-    if( left_first != last ) // remember left block if not finished
-    {
-      remainingBlocks[tid] = left_first - first;
-      p_++;
-    }
-    else if( right_first != last ) // remember right block if not finished
-    {
-      remainingBlocks[tid] = right_first - first;
-      p_++;
-    }
-#pragma omp atomic
-    RN += RN_;
-#pragma omp atomic
-    LN += LN_;
-#pragma omp atomic
-    p += p_;
-}// end omp task
-  }
-#pragma omp taskwait
+  if( BlockSize > 0 ) return BlockSize;
+  static const long size = block_size_for( sizeof(T), detect_l1d_cache_size(),
+                                           detect_smt() );
+  return size;
 }
 
-// launches a parallel region if not has been started already
-// invokes the actual parallel phase
-template< class FwdIt, class Predicate >
-inline void parallel_phase_run( const bool omp_parallel_active,
-                                const FwdIt first, const FwdIt last,
-                                const Predicate pred, const int num,
-                                long &LN, long &RN,
-                                int &p, long *remainingBlocks )
+// execution context
+// every entry point opens its own OpenMP team, which dominates the time for
+// medium-sized arrays called back to back, a ppq::context keeps one team
+// alive instead: its driver thread stays inside a parallel region and runs
+// the team body of every call on all threads of the team
+// the entry points accept the context as first argument, e.g.
+//   ppq::context ctx;
+//   pquicksort( ctx, v.begin(), v.end() );
+// arrays below serial_threshold are handled by the calling thread without
+// the team, the scratch space is kept between calls
+namespace ppq
 {
-  if( omp_parallel_active )
-  {
-    parallel_phase( first, last, pred, num, LN, RN, p, remainingBlocks );
-  }
-  else
+// yields of a waiting thread before it sleeps
+constexpr int context_spin_count = 1000;
+
+class context
+{
+public:
+  explicit context( const int num = omp_get_max_threads(),
+                    const long serial_threshold = 1L << 12 )
+    : num( num < 1 ? 1 : num ), serial( serial_threshold )
   {
-#pragma omp parallel
-#pragma omp single
-    parallel_phase( first, last, pred, num, LN, RN, p, remainingBlocks );
+    driver = std::thread( [this]() { drive(); } );
   }
-}
 
-// is faster than quicksort for small arrays
-template< class FwdIt >
-inline void insertion_sort( FwdIt first, FwdIt last )
-{
-  int i = 1;
-  while( i < (last - first) )
+  ~context()
   {
-    const auto x = *(first + i);
-    int j = i-1;
-    while( ( j >= 0 ) && ( *(first + j) > x ) )
     {
-      *(first + j + 1) = *(first + j);
-      --j;
+      std::lock_guard<std::mutex> lock( mutex );
+      stop = true;
     }
-    *(first + j + 1) = x;
-    ++i;
+    wake.notify_all();
+    driver.join();
   }
-}
-
-// one processor partitions the array blockwise
-// first, last = array borders
-// num = number of threads in previous parallel_phase
-// p = number of remaining blocks after parallel phase
-// LN, RN = partitioned left/right-side elements
-// left, right = remember state of processed remainingBlocks
-// remainingBlocks = remembers first element-index of all remaining blocks
-template< class FwdIt, class Predicate >
-inline void sequ_neutralization( const FwdIt first, const FwdIt last,
-                                 const Predicate pred, const int num, const int p,
-                                 long &LN, long &RN, int &left, int &right,
-                                 long *remainingBlocks )
-{
-  // sorts remaining blocks (smallest element-index first)
-  insertion_sort( remainingBlocks, remainingBlocks+num );
 
-  const long N = last - first;
-  left = 0;
-  right = p-1;
+  context( const context& ) = delete;
+  context &operator=( const context& ) = delete;
 
-  auto left_first = first + remainingBlocks[left];
-  auto left_last = left_first + B;
-  auto right_first = first + remainingBlocks[right];
-  auto right_last = right_first + B;
-  if (right_last > last) right_last = last;
+  int threads() const { return num; }
+  long serial_threshold() const { return serial; }
 
-  while( left < right )
+  // runs body on every thread of the team like a parallel region
+  // returns after all threads finished body
+  template< class Body >
+  void run( const Body &body )
   {
-    auto result = neutralize(left_first, left_last, right_first, right_last, pred);
-    if( result%2 == 0 ) // left-side block was obtained
-    {
-      if( left_first <= first + LN )
-      {
-        LN += B;
-        remainingBlocks[left] = last - first;
-      }
-      left++;
-      left_first = first + remainingBlocks[left];
-      left_last = left_first + B;
-    }
-    if( result > 0 ) // right-side block was obtained
+    std::lock_guard<std::mutex> one_job( submit );
     {
-      if ( right_first >= last - RN - B )
-      {
-        RN += right_last - right_first;
-        remainingBlocks[right] = last - first;
-      }
-      right--;
-      right_first = first + remainingBlocks[right];
-      right_last = right_first + B;
+      std::lock_guard<std::mutex> lock( mutex );
+      job_body = &body;
+      job = []( const void *b ) { (*static_cast<const Body*>( b ))(); };
+      ++submitted;
     }
+    wake.notify_all();
+    await( [this]() { return finished == submitted; } );
   }
-}
 
-// swapps two blocks
-template< class FwdIt >
-inline void swapBlocks( const FwdIt left_first, const FwdIt left_last,
-                        const FwdIt right_first, const FwdIt right_last )
-{
-  if( right_first != left_first )
+  // scratch space of at least bytes bytes, valid until the next call
+  // only for intern use of the entry point holding the team: it may only be
+  // taken inside a body given to run, which serializes the calls
+  void *scratch( const std::size_t bytes )
   {
-    auto tmp = *left_first;
-    auto left_it = left_first;
-    auto right_it = right_first;
-    while( (left_it < left_last) && (right_it < right_last) )
+    if( bytes > scratch_size )
     {
-      tmp = *left_it;
-      *left_it = *right_it;
-      *right_it = tmp;
-      left_it++;
-      right_it++;
+      scratch_space.reset( new std::max_align_t[ bytes / sizeof(std::max_align_t) + 1 ] );
+      scratch_size = bytes;
     }
+    return scratch_space.get();
   }
-}
 
-// one processor swapps blocks into the inteded position
-// first, last = array borders
-// p = number of remaining blocks after parallel phase
-// LN, RN = partitioned left/right-side elements
-// left, right = remember state of processed remainingBlocks
-// remainingBlocks = remembers first element-index of all remaining blocks
-template< class FwdIt >
-inline void sequ_swapping( const FwdIt first, const FwdIt last,
-                           const int p, const int left, const int right,
-                           long &LN, long &RN, long *remainingBlocks )
-{
-  const long N = last - first;
-  FwdIt left_first, left_last, right_first, right_last;
-  // right blocks are swapped into intended position
-  for( int i = right+1; i < p; i++ )
+  // the context of the calling thread, nullptr outside of a scope
+  static context *&current()
   {
-    if( remainingBlocks[i] != last - first )
-    {
-      left_first = last - RN - B;
-      left_last = left_first + B;
-      right_first = first + remainingBlocks[i];
-      right_last = right_first + B;
-
-      swapBlocks( left_first, left_last, right_first, right_last );
-      RN += B;
+    static thread_local context *ctx = nullptr;
+    return ctx;
+  }
 
-      for( int k = p-1; k > i; k-- )
-      {
-        if( remainingBlocks[k] == N - RN - B )
-        {
-          remainingBlocks[k] = last - first;
-          RN += B;
-        }
-      }
-    }
+  // the context whose team runs the calling thread inside a body given to
+  // run, nullptr on all other threads and in teams nested into the body
+  // only the team may take the scratch space
+  static context *team()
+  {
+    return omp_get_level() == 1 ? member() : nullptr;
   }
-  // left blocks are swapped into intended position
-  for( int i = left-1; i >= 0 ; i-- )
+
+  // makes ctx the context of the entry points called by this thread
+  class scope
+  {
+  public:
+    explicit scope( context &ctx ) : previous( current() ) { current() = &ctx; }
+    ~scope() { current() = previous; }
+  private:
+    context *previous;
+  };
+
+private:
+  // yields for a short time before sleeping until done() holds, back to back
+  // calls are handed over without waking a sleeping thread
+  template< class Done >
+  void await( const Done &done )
   {
-    if( remainingBlocks[i] != last - first )
+    for( int spin = 0; spin < context_spin_count; ++spin )
     {
-      right_first = first + LN;
-      right_last = right_first + B;
-      left_first = first + remainingBlocks[i];
-      left_last = left_first + B;
+      if( done() ) return;
+      std::this_thread::yield();
+    }
+    std::unique_lock<std::mutex> lock( mutex );
+    wake.wait( lock, done );
+  }
 
-      swapBlocks( left_first, left_last, right_first, right_last );
-      LN += B;
+  static context *&member()
+  {
+    static thread_local context *ctx = nullptr;
+    return ctx;
+  }
 
-      for( int k = 0; k < i; k++ )
+  // the team waits at the barrier between two jobs
+  // the team threads see the context as team() for its scratch space
+  void drive()
+  {
+    bool stopping = false;
+#pragma omp parallel num_threads( num ) shared( stopping )
+    {
+      member() = this;
+      for( ;; )
       {
-        if( remainingBlocks[k] == LN )
+#pragma omp master
+        {
+          await( [this]() { return stop || submitted > finished; } );
+          stopping = submitted == finished;
+        }
+#pragma omp barrier
+        if( stopping ) break;
+        job( job_body );
+#pragma omp barrier
+#pragma omp master
         {
-          remainingBlocks[k] = last - first;
-          LN += B;
+          {
+            std::lock_guard<std::mutex> lock( mutex );
+            ++finished;
+          }
+          wake.notify_all();
         }
       }
+      member() = nullptr;
     }
   }
-  // not neutralzed block is swapped into intended position
-  if( left == right )
-  {
-    right_first = first + LN;
-    right_last = right_first + B;
-    left_first = first + remainingBlocks[right];
-    left_last = left_first + B;
-    if( left_last > last ) left_last = last;
 
-    swapBlocks( left_first, left_last, right_first, right_last );
-  }
-}
+  const int num;
+  const long serial;
+  std::thread driver;
+  std::mutex submit;
+  std::mutex mutex;
+  std::condition_variable wake;
+  // type-erased body of the current job
+  void (*job)( const void* ) = nullptr;
+  const void *job_body = nullptr;
+  std::atomic<long> submitted{ 0 };
+  std::atomic<long> finished{ 0 };
+  std::atomic<bool> stop{ false };
+  std::unique_ptr<std::max_align_t[]> scratch_space;
+  std::size_t scratch_size = 0;
+};
+} // namespace ppq
 
-// partitions an array single-threaded
-template< class FwdIt, class Predicate >
-constexpr FwdIt spartition( const FwdIt first, const FwdIt last,
-                            const Predicate pred )
+// runs body on every thread of a team of num threads, the persistent team
+// of the current ppq::context if it has num threads or a new team
+template< class Body >
+inline void team_run( const int num, const Body &body )
 {
-  int split = 0;
-  // finds splitting point
-  for( auto iter = first; iter < last; ++iter )
+  ppq::context *ctx = ppq::context::current();
+  if( ctx != nullptr && ctx->threads() == num && !omp_in_parallel() )
   {
-    if( pred(*iter) ) ++split;
+    ctx->run( body );
+    return;
   }
-  // partitions array and returns first element of right-side group
-  neutralize( first, first+split, first+split, last, pred );
-  return first+split;
+#pragma omp parallel num_threads( num )
+  body();
 }
 
-// combines previous parts to a parallel partioner
-template< class FwdIt, class Predicate >
-constexpr FwdIt ppartition( const FwdIt first, const FwdIt last,
-                            const Predicate pred,
-                            const int num = omp_get_max_threads(),
-                            const bool omp_parallel_active = false )
+// number of threads of the team team_run opens for the entry points without
+// a num argument
+inline int team_threads()
 {
-  // partitioned left-side / right-side elements
-  long LN, RN;
-  // number of unsorted blocks after parallel_phase
-  int p;
-  // counter for remaining left/right-sided blocks
-  int left, right;
-  // here, every processors inserts its remaining block after the parallel_phase
-  long remainingBlocks[num];
-  // all processors partition the array blockwise
-  parallel_phase_run( omp_parallel_active, first, last, pred, num,
-                      LN, RN, p, remainingBlocks );
-  // the remaining blocks are partitioned sequentially
-  sequ_neutralization( first, last, pred, num, p,
-                       LN, RN, left, right, remainingBlocks );
-  // the sequentially-partitioned blocks are ordered
-  sequ_swapping( first, last, p, left, right, LN, RN, remainingBlocks );
-  // the last remaining block is partitioned and
-  // the first element of the right-side group is returned
-  return spartition( first+LN, last-RN, pred );
-}
-
-template< class Elem >
-Elem medianOfThree( const Elem a, const Elem b, const Elem c )
-{
-    if( (a > b) xor (a > c) )
-        return a;
-    else if( (b < a) xor (b < c) )
-        return b;
-    else
-        return c;
+  const ppq::context *ctx = ppq::context::current();
+  return ( ctx != nullptr && !omp_in_parallel() ) ? ctx->threads() : omp_get_max_threads();
 }
 
-// standard quicksort, per default single threaded
-// launch with pquicksort to run in parallel
-// num = number of threads, only for intern use
-template< class FwdIt, class Compare = std::less<> >
-void quicksort( const FwdIt first, const FwdIt last,
-                const Compare cmp = Compare{},
-                const int num = 1 )
+// scratch arena
+// the partitionings and the pivot sampling take their bookkeeping (remaining
+// blocks, block states, swap plan, NUMA segments, pivot samples) from a
+// per-thread arena instead of the stack or the heap: the space is taken by a
+// scratch_frame and given back when the frame ends, in the order of the
+// stack, so the recursion of the sorts reuses the same bytes
+// every thread keeps its arena between calls, the entry points reserve the
+// space of the whole sort on all threads of the team before the recursion
+// starts, so the recursion does not allocate
+namespace ppq
 {
-  const long distance = std::distance( first, last );
-  // insertionsort is faster for small arrays
-  if( distance <= 32 )
+class scratch_arena
+{
+public:
+  // the arena of the calling thread
+  static scratch_arena &local()
   {
-    insertion_sort( first, last );
-    return;
+    static thread_local scratch_arena arena;
+    return arena;
   }
-  // median of three as pivot is more robust for natrual distributions
-  const auto pivot = medianOfThree( *first, *std::prev( last, 1 ),
-                                    *std::next( first, distance/2 ) );
-
-  // two partitionings to avoid getting stuck
-  const auto cmp1 = [=]( const auto &elem ){ return cmp( elem, pivot ); };
-  const auto cmp2 = [=]( const auto &elem ){ return !cmp( pivot, elem ); };
-  FwdIt middle1, middle2;
 
-  // ppartitioning is more efficient for arrays not fitting in cache
-  // spartitioning has less overhead once the array fitts in cache
-  if( distance >= 2*B )
+  // makes sure that bytes can be taken without allocating
+  void reserve( const std::size_t bytes )
   {
-    middle1 = ppartition( first, last, cmp1, num, true );
-    middle2 = ppartition( middle1, last, cmp2, num, true );
+    if( chunks.empty() || ( top.chunk == 0 && top.used == 0 && chunks[0].size < bytes ) )
+    {
+      chunks.clear();
+      add_chunk( bytes );
+    }
   }
-  else
+
+private:
+  friend class scratch_frame;
+
+  struct chunk
+  {
+    std::unique_ptr<std::max_align_t[]> space;
+    std::size_t size;
+  };
+  struct position
   {
-    middle1 = spartition( first, last, cmp1 );
-    middle2 = spartition( middle1, last, cmp2 );
+    std::size_t chunk = 0;
+    std::size_t used = 0;
+  };
+
+  void add_chunk( const std::size_t bytes )
+  {
+    const std::size_t words = bytes / sizeof( std::max_align_t ) + 1;
+    chunks.push_back( { std::unique_ptr<std::max_align_t[]>( new std::max_align_t[words] ),
+                        words * sizeof( std::max_align_t ) } );
   }
 
-  // ONLY necessary for parallel quicksort (see below)
-  // distributs cores according to remaining work
-  int new_num1 = num;
-  int new_num2 = num;
-  const long distance1 = std::distance( first, middle1 );
-  const long distance2 = std::distance( middle2, last );
-  if( num > 1 )
+  // aligned space of bytes bytes, taken from the current chunk or the next
+  // one that is large enough, taken chunks are never moved
+  void *take( const std::size_t bytes )
   {
-    const float share = 1.0 * distance1 / ( distance1 + distance2 );
-    new_num1 = ( (int)(share * num) < 1 ) ? 1 : share * num;
-    new_num2 = ( (num - new_num1) < 1 ) ? 1 : num - new_num1;
+    const std::size_t align = alignof( std::max_align_t );
+    const std::size_t size = ( bytes + align - 1 ) / align * align;
+    while( top.chunk < chunks.size() && top.used + size > chunks[top.chunk].size )
+    {
+      ++top.chunk;
+      top.used = 0;
+    }
+    if( top.chunk == chunks.size() )
+      add_chunk( std::max( size, chunks.empty() ? size : 2 * chunks.back().size ) );
+    void *result = reinterpret_cast<char*>( chunks[top.chunk].space.get() ) + top.used;
+    top.used += size;
+    return result;
   }
-  // recursive quicksort calls
-  // pragmas are ONLY considered when invoked from parallel quicksort
-  // if arraysize over 10000, start new tasks
-#pragma omp task if( distance1 > 10000 )
-  quicksort( first, middle1, cmp, new_num1 );
-#pragma omp task if( distance2 > 10000 )
-  quicksort( middle2, last, cmp, new_num2 );
-// omp taskwait is necessary for the icpc compiler
-// please comment out for max performance with the g++ compiler
-#pragma omp taskwait
-}
 
-// parallel quicksort starter
-template< class FwdIt, class Compare = std::less<> >
-void pquicksort( const FwdIt first, const FwdIt last,
-                 const Compare cmp = Compare{} )
-{
-#pragma omp parallel
-#pragma omp single
-  quicksort( first, last, cmp, omp_get_max_threads() );
-}
+  std::vector<chunk> chunks;
+  position top;
+};
 
-// dual pivot quicksort, per default single threaded
-// launch with pquicksort to run in parallel
-// num = number of threads, only for intern use
-template< class FwdIt, class Compare = std::less<> >
-void quicksort_dual_pivot( const FwdIt first, const FwdIt last,
-                           const Compare cmp = Compare{},
-                           const int num = 1 )
+// space taken from the arena of the calling thread, given back at the end
+// of the scope, only for trivially destructible types
+class scratch_frame
 {
-  const int distance = std::distance( first, last );
-  // insertionsort is faster for small arrays
-  if( distance <= 32 )
-  {
-    insertion_sort(first, last);
-    return;
-  }
-  // median of three as pivot is more robust for natrual distributions
-  auto pivot1 = medianOfThree( *first, *std::prev( last, 1 ),
-                               *std::next( first, distance/2 ) );
-  auto pivot2 = medianOfThree( *std::next( first, distance/2 ),
-                               *std::next( first, 3*distance/4 ),
-                               *std::prev( last, 1 ) );
-  // swap pivots if second is smaller than first one
-  if ( pivot1 > pivot2 ){
-    auto tmp = pivot1;
-    pivot1 = pivot2;
-    pivot2 = tmp;
-  }
-  // four partitionings to avoid getting stuck
-  const auto cmp11 = [=]( const auto &elem ){ return cmp( elem, pivot1 ); };
-  const auto cmp12 = [=]( const auto &elem ){ return !cmp( pivot1, elem ); };
-  const auto cmp21 = [=]( const auto &elem ){ return cmp( elem, pivot2 ); };
-  const auto cmp22 = [=]( const auto &elem ){ return !cmp( pivot2, elem ); };
-  FwdIt middle11, middle12, middle21, middle22;
+public:
+  scratch_frame() : arena( scratch_arena::local() ), start( arena.top ) {}
+  ~scratch_frame() { arena.top = start; }
+  scratch_frame( const scratch_frame& ) = delete;
+  scratch_frame &operator=( const scratch_frame& ) = delete;
 
-  // ppartitioning is more efficient for arrays not fitting in cache
-  // spartitioning has less overhead once the array fitts in cache
-  if( distance >= 2*B )
+  // count value-initialized objects
+  template< class T >
+  T *take( const std::size_t count )
   {
-    middle11 = ppartition( first, last, cmp11, num, true );
-    middle12 = ppartition( middle11, last, cmp12, num, true );
-    middle21 = ppartition( middle12, last, cmp21, num, true );
-    middle22 = ppartition( middle21, last, cmp22, num, true );
+    static_assert( std::is_trivially_destructible<T>::value,
+                   "the arena does not run destructors" );
+    // over-aligned types, e.g. one cache line per object, take their
+    // alignment in addition
+    constexpr std::size_t align = alignof( T ) > alignof( std::max_align_t ) ? alignof( T ) : 1;
+    const std::uintptr_t raw =
+      reinterpret_cast<std::uintptr_t>( arena.take( count * sizeof( T ) + align - 1 ) );
+    T *space = reinterpret_cast<T*>( ( raw + align - 1 ) / align * align );
+    for( std::size_t k = 0; k < count; ++k ) ::new( static_cast<void*>( space + k ) ) T();
+    return space;
   }
-  else
+
+private:
+  scratch_arena &arena;
+  scratch_arena::position start;
+};
+
+// vector with a fixed capacity in a scratch_frame
+template< class T >
+class scratch_vector
+{
+public:
+  scratch_vector( scratch_frame &frame, const std::size_t capacity )
+    : data_( frame.take<T>( capacity ) ) {}
+
+  std::size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  T *begin() { return data_; }
+  T *end() { return data_ + size_; }
+  const T *begin() const { return data_; }
+  const T *end() const { return data_ + size_; }
+  T &operator[]( const std::size_t k ) { return data_[k]; }
+  const T &operator[]( const std::size_t k ) const { return data_[k]; }
+  T &back() { return data_[size_ - 1]; }
+  void push_back( const T &value ) { data_[size_++] = value; }
+  void resize( const std::size_t size ) { size_ = size; }
+  T *insert( T *position, const T &value )
   {
-    middle11 = spartition( first, last, cmp11 );
-    middle12 = spartition( middle11, last, cmp12 );
-    middle21 = spartition( middle12, last, cmp21 );
-    middle22 = spartition( middle21, last, cmp22 );
+    std::copy_backward( position, end(), end() + 1 );
+    ++size_;
+    *position = value;
+    return position;
   }
-  // ONLY necessary for parallel quicksort (see below)
-  // distributs cores according to remaining work
-  int new_num1 = num;
-  int new_num2 = num;
-  int new_num3 = num;
-  const long distance1 = std::distance( first, middle11 );
-  const long distance2 = std::distance( middle12, middle21 );
-  const long distance3 = std::distance( middle22, last );
-
-  if ( num > 1 ) {
-    const long elems = distance1 + distance2 + distance3;
-    const float share1 = 1.0 * distance1 / elems;
-    const float share2 = 1.0 * distance2 / elems;
-    new_num1 = ((int)(share1 * num) < 1) ? 1 : share1 * num;
-    new_num2 = ((int)(share2 * num) < 1) ? 1 : share2 * num;
-    new_num3 = ((num-new_num1-new_num2) < 1) ? 1 : num-new_num1-new_num2;
-  }
-  // recursive quicksort calls
-  // pragmas are ONLY considered when invoked from parallel quicksort
-  // if arraysize over 10000, start new tasks
-#pragma omp task if ( distance1 > 10000 )
-  quicksort_dual_pivot(first, middle11, cmp, new_num1);
-#pragma omp task if ( distance2 > 10000 )
-  quicksort_dual_pivot(middle12, middle21, cmp, new_num2);
-#pragma omp task if ( distance3 > 10000 )
-  quicksort_dual_pivot(middle22, last, cmp, new_num3);
-#pragma omp taskwait
+
+private:
+  T *data_;
+  std::size_t size_ = 0;
+};
+
+// bytes of the scratch space of the NUMA mode of num threads without the
+// cleanups of its segments, 0 on one node, see numa_partitioning
+inline std::size_t numa_scratch_bytes( const int num );
+
+// bytes of the scratch space of one partitioning of num threads
+inline std::size_t partition_scratch_bytes( const int num )
+{
+  // remaining blocks of the parallel phase, the block states, the mixed
+  // blocks and the swap plan of parallel_cleanup, and the alignment
+  const std::size_t blocks = num + 2;
+  return 2 * blocks * sizeof( long ) + blocks * sizeof( std::pair<long, long> ) +
+         3 * blocks * sizeof( long ) + 8 * alignof( std::max_align_t ) +
+         numa_scratch_bytes( num );
 }
 
-// parallel dual pivot quicksort starter
-template< class FwdIt, class Compare = std::less<> >
-void pquicksort_dual_pivot( const FwdIt first, const FwdIt last,
-                            const Compare cmp = Compare{} )
+// bytes of the scratch space of the three-way partitioning of n elements
+// in blocks of B elements, see block_partitioning3
+inline std::size_t partition3_scratch_bytes( const long n, const long B, const int num );
+
+// bytes of the scratch space of a sort of n elements with num threads:
+// the pivot samples of the largest range or one three-way partitioning in
+// blocks of the default size, nested in the partitioning of the
+// work-stealing scheduler
+template< class FwdIt >
+inline std::size_t sort_scratch_bytes( const long n, const int num )
 {
-#pragma omp parallel
-#pragma omp single nowait
-  quicksort_dual_pivot( first, last, cmp, omp_get_max_threads() );
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  const std::size_t samples =
+    ( static_cast<std::size_t>( std::sqrt( static_cast<double>( n ) ) ) + 2 ) * sizeof( FwdIt );
+  return num * sizeof( long ) + alignof( std::max_align_t ) +
+         std::max( samples + alignof( std::max_align_t ),
+                   partition_scratch_bytes( num ) +
+                   partition3_scratch_bytes( n, block_size< 0, T >(), num ) );
 }
 
-// parallel quickselect
-template< class FwdIt, class Compare = std::less<> >
-void pquickselect( const FwdIt first, const FwdIt nth, const FwdIt last,
-                   const Compare cmp = Compare{},
-                   const int num = omp_get_max_threads() )
+// reserves bytes in the arena of the calling thread, called by every
+// thread of a team at the start of an entry point
+inline void reserve_scratch( const std::size_t bytes )
 {
-  if( first == last ) return;
+  scratch_arena::local().reserve( bytes );
+}
+} // namespace ppq
 
-  const int distance = std::distance( first, last );
+// statistics
+// compiled in with PPQ_STATS only, without it the hooks are empty and the
+// timers have no members, so the hot paths are unchanged
+//   ppq::stats stats;
+//   {
+//     ppq::stats_scope collect( stats );
+//     ppartition( v.begin(), v.end(), pred );
+//   }
+//   std::cout << stats.json();
+// the hooks of all threads record into the stats of the innermost scope,
+// one collection at a time per process
+namespace ppq
+{
+// phases of a parallel partitioning
+// parallel_phase = blocks claimed and neutralized by all threads
+// neutralization = pairwise neutralization of the remaining blocks
+// swapping = misplaced blocks swapped across the border
+// final_partition = the last mixed block partitioned sequentially
+enum stats_phase { parallel_phase_time, neutralization_time, swapping_time,
+                   final_partition_time, stats_phases };
 
-  // median of three as pivot is more robust for natrual distributions
-  const auto pivot = medianOfThree( *first, *std::prev( last, 1 ),
-                                    *std::next( first, distance/2 ) );
+// threads with their own block counter, higher numbers share the last one
+constexpr int stats_threads = 256;
 
-  // two partitionings to avoid getting stucked
-  const auto cmp1 = [=]( const auto &elem ){ return cmp( elem, pivot ); };
-  const auto cmp2 = [=]( const auto &elem ){ return !cmp( pivot, elem ); };
-  FwdIt middle1, middle2;
+struct stats
+{
+  // nanoseconds per phase, summed over all partitionings
+  std::atomic<long> phase_ns[stats_phases] = {};
+  // parallel partitionings, ppartition and the cooperative ones of the sorts
+  std::atomic<long> partitions{ 0 };
+  // largest number of threads of a partitioning (p)
+  std::atomic<long> threads{ 0 };
+  // blocks claimed per OpenMP thread number
+  std::atomic<long> thread_blocks[stats_threads] = {};
+  // remaining blocks after the parallel phase, sum and maximum
+  std::atomic<long> remaining_blocks{ 0 };
+  std::atomic<long> max_remaining_blocks{ 0 };
+  // deepest recursion level of the sorts below the largest depth limit
+  // (2*log2(n) of the whole array) and partitionings flagged as bad
+  std::atomic<long> depth_limit{ 0 };
+  std::atomic<long> max_depth{ 0 };
+  std::atomic<long> bad_partitions{ 0 };
+  // tasks started by the partitionings, ranges pushed and stolen by the
+  // work-stealing scheduler
+  std::atomic<long> tasks{ 0 };
+  std::atomic<long> pushed_ranges{ 0 };
+  std::atomic<long> stolen_ranges{ 0 };
+  // optional callback at every phase boundary, e.g. to read hardware
+  // counters: phase = the phase which just ended, stats_phases at the start
+  // of a timed section; called by the thread running the partitioning
+  void ( *phase_hook )( void *data, int phase ) = nullptr;
+  void *phase_data = nullptr;
 
+  double seconds( const stats_phase phase ) const { return phase_ns[phase] * 1e-9; }
+
+  std::string json() const
+  {
+    static const char *const names[stats_phases] = {
+      "parallel_phase", "neutralization", "swapping", "final_partition" };
+    std::string out = "{\n  \"phase_seconds\": {";
+    for( int phase = 0; phase < stats_phases; ++phase )
+      out += std::string( phase ? ", " : " " ) + "\"" + names[phase] + "\": " +
+             std::to_string( seconds( static_cast<stats_phase>( phase ) ) );
+    out += " },\n  \"thread_blocks\": [";
+    int used = stats_threads;
+    while( used > 0 && thread_blocks[used - 1] == 0 ) --used;
+    for( int t = 0; t < used; ++t )
+      out += std::string( t ? ", " : " " ) + std::to_string( thread_blocks[t].load() );
+    out += " ],\n";
+    auto field = [&out]( const char *name, const long value, const bool last = false )
+    {
+      out += std::string( "  \"" ) + name + "\": " + std::to_string( value ) +
+             ( last ? "\n" : ",\n" );
+    };
+    field( "partitions", partitions );
+    field( "threads", threads );
+    field( "remaining_blocks", remaining_blocks );
+    field( "max_remaining_blocks", max_remaining_blocks );
+    field( "depth_limit", depth_limit );
+    field( "max_depth", max_depth );
+    field( "bad_partitions", bad_partitions );
+    field( "tasks", tasks );
+    field( "pushed_ranges", pushed_ranges );
+    field( "stolen_ranges", stolen_ranges, true );
+    return out + "}\n";
+  }
+};
+
+// the stats the hooks record into, nullptr outside of a scope
+inline stats *&active_stats()
+{
+  static stats *active = nullptr;
+  return active;
+}
+
+// makes s the stats of all calls until the end of the scope
+class stats_scope
+{
+public:
+  explicit stats_scope( stats &s ) : previous( active_stats() ) { active_stats() = &s; }
+  ~stats_scope() { active_stats() = previous; }
+private:
+  stats *previous;
+};
+
+#if defined( PPQ_STATS )
+inline void stats_max( std::atomic<long> &target, const long value )
+{
+  long current = target.load( std::memory_order_relaxed );
+  while( current < value && !target.compare_exchange_weak( current, value ) ) {}
+}
+
+// adds value to the counter selected by member
+template< class Member >
+inline void stats_add( const Member member, const long value )
+{
+  if( stats *s = active_stats() ) ( s->*member ).fetch_add( value, std::memory_order_relaxed );
+}
+
+inline void stats_thread_blocks( const long blocks )
+{
+  if( stats *s = active_stats() )
+    s->thread_blocks[ std::min( omp_get_thread_num(), stats_threads - 1 ) ]
+      .fetch_add( blocks, std::memory_order_relaxed );
+}
+
+// one parallel partitioning of num threads with remaining blocks left
+inline void stats_partition( const int num, const long remaining )
+{
+  if( stats *s = active_stats() )
+  {
+    s->partitions.fetch_add( 1, std::memory_order_relaxed );
+    s->remaining_blocks.fetch_add( remaining, std::memory_order_relaxed );
+    stats_max( s->threads, num );
+    stats_max( s->max_remaining_blocks, remaining );
+  }
+}
+
+// depth limit of a sort of the whole array
+inline void stats_depth_limit( const int limit )
+{
+  if( stats *s = active_stats() ) stats_max( s->depth_limit, limit );
+}
+
+// recursion level of a sort with remaining levels until the fallback
+inline void stats_depth( const int remaining )
+{
+  if( stats *s = active_stats() )
+    stats_max( s->max_depth, s->depth_limit.load( std::memory_order_relaxed ) - remaining );
+}
+
+// adds the time since the start or the last next() to the current phase
+class stats_timer
+{
+public:
+  explicit stats_timer( const stats_phase phase ) : phase( phase )
+  {
+    stats *s = active_stats();
+    if( s && s->phase_hook ) s->phase_hook( s->phase_data, stats_phases );
+    start = std::chrono::steady_clock::now();
+  }
+  ~stats_timer() { next( phase ); }
+  void next( const stats_phase following )
+  {
+    const auto now = std::chrono::steady_clock::now();
+    if( stats *s = active_stats() )
+    {
+      s->phase_ns[phase].fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>( now - start ).count(),
+        std::memory_order_relaxed );
+      // the time of the hook is not counted
+      if( s->phase_hook ) s->phase_hook( s->phase_data, phase );
+    }
+    phase = following;
+    start = std::chrono::steady_clock::now();
+  }
+private:
+  stats_phase phase;
+  std::chrono::steady_clock::time_point start;
+};
+#else
+template< class Member >
+inline void stats_add( const Member, const long ) {}
+inline void stats_thread_blocks( const long ) {}
+inline void stats_partition( const int, const long ) {}
+inline void stats_depth_limit( const int ) {}
+inline void stats_depth( const int ) {}
+
+class stats_timer
+{
+public:
+  explicit stats_timer( const stats_phase ) {}
+  void next( const stats_phase ) {}
+};
+#endif
+} // namespace ppq
+
+// receives two blocks and obtains one left-side or one right-side block or both
+// returns 1 for a left-side, 2 for a right.side block, and 3 for both
+template< class FwdIt, class Predicate >
+inline constexpr int neutralize( const FwdIt left_first, const FwdIt left_last,
+                                 const FwdIt right_first, const FwdIt right_last,
+                                 const Predicate pred )
+{
+  auto left_it = left_first;
+  auto right_it = right_first;
+  while( left_it <= left_last && right_it <= right_last)
+  {
+    for( ; left_it < left_last; left_it++ )
+      if( !pred(*left_it) ) break;
+
+    for( ; right_it < right_last; right_it++ )
+      if( pred(*right_it) ) break;
+
+    if( (left_it == left_last) || (right_it == right_last) ) break;
+
+    std::iter_swap( left_it, right_it );
+
+    ++left_it; ++right_it;
+  }
+
+  if( (left_it == left_last) && (right_it == right_last) ) return 2;
+  if( left_it == left_last ) return 0;
+  return 1;
+}
+
+// number of elements scanned at once by neutralize_branchless
+// offsets of misplaced elements within a chunk fit in an unsigned char
+constexpr int offset_buffer_size = 128;
+// the vectorized scanner stores up to 16 offsets past the last valid one
+constexpr int offset_buffer_slack = 16;
+
+// scalar scanner of neutralize_blockwise
+// writes the offsets of all elements with pred(elem) == Want without branches
+// returns the number of offsets written
+struct scalar_scanner
+{
+  template< bool Want, class FwdIt, class Predicate >
+  static int scan( const FwdIt it, const int size, unsigned char *offsets,
+                   const Predicate &pred )
+  {
+    int num = 0;
+    for( int k = 0; k < size; ++k )
+    {
+      offsets[num] = k;
+      num += ( static_cast<bool>( pred( *(it + k) ) ) == Want );
+    }
+    return num;
+  }
+
+  // counts all elements with pred(elem) == true
+  template< class FwdIt, class Predicate >
+  static long count( const FwdIt first, const FwdIt last, const Predicate &pred )
+  {
+    long num = 0;
+    for( auto iter = first; iter < last; ++iter )
+      num += static_cast<bool>( pred( *iter ) );
+    return num;
+  }
+};
+
+// branchless variant of neutralize (BlockQuicksort, Edelkamp and Weiss)
+// both blocks are scanned chunkwise, the offsets of misplaced elements are
+// written to a buffer without branches and then swapped in a batch
+// Scanner = fills the offset buffers, see scalar_scanner
+// returns the same values as neutralize
+template< class Scanner, class FwdIt, class Predicate >
+inline int neutralize_blockwise( const FwdIt left_first, const FwdIt left_last,
+                                 const FwdIt right_first, const FwdIt right_last,
+                                 const Predicate pred )
+{
+  unsigned char offsets_left[offset_buffer_size + offset_buffer_slack];
+  unsigned char offsets_right[offset_buffer_size + offset_buffer_slack];
+  // next element to scan and first element of the current chunk
+  auto left_it = left_first;
+  auto right_it = right_first;
+  auto left_chunk = left_first;
+  auto right_chunk = right_first;
+  // misplaced elements left in the buffers
+  int num_left = 0, num_right = 0;
+  int start_left = 0, start_right = 0;
+
+  while( true )
+  {
+    if( num_left == 0 )
+    {
+      if( left_it == left_last ) break;
+      const int size = ( left_last - left_it < offset_buffer_size )
+                       ? left_last - left_it : offset_buffer_size;
+      left_chunk = left_it;
+      start_left = 0;
+      num_left = Scanner::template scan< false >( left_it, size, offsets_left, pred );
+      left_it += size;
+    }
+    if( num_right == 0 )
+    {
+      if( right_it == right_last ) break;
+      const int size = ( right_last - right_it < offset_buffer_size )
+                       ? right_last - right_it : offset_buffer_size;
+      right_chunk = right_it;
+      start_right = 0;
+      num_right = Scanner::template scan< true >( right_it, size, offsets_right, pred );
+      right_it += size;
+    }
+    // swaps as many misplaced elements as both buffers hold
+    const int num = ( num_left < num_right ) ? num_left : num_right;
+    for( int k = 0; k < num; ++k )
+    {
+      std::iter_swap( left_chunk + offsets_left[start_left + k],
+                      right_chunk + offsets_right[start_right + k] );
+    }
+    num_left -= num; start_left += num;
+    num_right -= num; start_right += num;
+  }
+
+  const bool left_done = ( num_left == 0 ) && ( left_it == left_last );
+  const bool right_done = ( num_right == 0 ) && ( right_it == right_last );
+  if( left_done && right_done ) return 2;
+  if( left_done ) return 0;
+  return 1;
+}
+
+template< class FwdIt, class Predicate >
+inline int neutralize_branchless( const FwdIt left_first, const FwdIt left_last,
+                                  const FwdIt right_first, const FwdIt right_last,
+                                  const Predicate pred )
+{
+  return neutralize_blockwise< scalar_scanner >( left_first, left_last,
+                                                 right_first, right_last, pred );
+}
+
+// predicates comparing against a pivot, built by quicksort and pquickselect
+// named types allow simd_kernel to recognize them
+// small trivially copyable pivots are held by value, so the scanning loops
+// keep them in a register, all others are referenced: they live in the
+// classifier and copying the predicate into every task never copies them
+template< class T >
+using pivot_holder = typename std::conditional< std::is_trivially_copyable<T>::value &&
+                                                sizeof( T ) <= 2 * sizeof( long ),
+                                                T, const T& >::type;
+
+// less_than_pivot: elem < pivot
+template< class T, class Compare >
+struct less_than_pivot
+{
+  pivot_holder<T> pivot;
+  Compare cmp;
+  template< class Elem >
+  bool operator()( const Elem &elem ) const { return cmp( elem, pivot ); }
+};
+
+// not_greater_than_pivot: !(pivot < elem)
+template< class T, class Compare >
+struct not_greater_than_pivot
+{
+  pivot_holder<T> pivot;
+  Compare cmp;
+  template< class Elem >
+  bool operator()( const Elem &elem ) const { return !cmp( pivot, elem ); }
+};
+
+// vectorized scanning for arithmetic keys compared against a pivot
+// AVX-512: mask compares and compress of the offsets
+// AVX2: compares, movemask and a permutation table
+// the instruction set is chosen at compile time (-march=native),
+// without AVX2 simd_kernel falls back to the branchless kernel
+#if defined( __AVX512F__ ) || defined( __AVX2__ )
+#define PPQ_SIMD 1
+#endif
+
+// checks whether the keys of type T have a vectorized comparison
+template< class T >
+struct simd_key
+{
+  static constexpr bool value =
+    ( std::is_integral<T>::value && std::is_signed<T>::value &&
+      ( sizeof(T) == 4 || sizeof(T) == 8 ) ) ||
+    std::is_same<T, float>::value || std::is_same<T, double>::value;
+};
+
+// checks whether Compare is std::less for T
+template< class Compare, class T >
+struct is_std_less
+{
+  static constexpr bool value = std::is_same<Compare, std::less<>>::value ||
+                                std::is_same<Compare, std::less<T>>::value;
+};
+
+// checks whether the iterator points into contiguous memory
+template< class It >
+struct is_contiguous_iterator
+{
+  using T = typename std::iterator_traits<It>::value_type;
+  static constexpr bool value =
+    std::is_pointer<It>::value ||
+    std::is_same<It, typename std::vector<T>::iterator>::value ||
+    std::is_same<It, typename std::vector<T>::const_iterator>::value;
+};
+
+// decides whether a predicate is evaluated vectorized
+// less = true for less_than_pivot, false for not_greater_than_pivot
+template< class Predicate, class It >
+struct simd_predicate
+{
+  static constexpr bool value = false;
+};
+
+template< class T, class Compare, class It >
+struct simd_predicate< less_than_pivot<T, Compare>, It >
+{
+  static constexpr bool value = simd_key<T>::value &&
+                                is_std_less<Compare, T>::value &&
+                                is_contiguous_iterator<It>::value;
+  static constexpr bool less = true;
+};
+
+template< class T, class Compare, class It >
+struct simd_predicate< not_greater_than_pivot<T, Compare>, It >
+{
+  static constexpr bool value = simd_key<T>::value &&
+                                is_std_less<Compare, T>::value &&
+                                is_contiguous_iterator<It>::value;
+  static constexpr bool less = false;
+};
+
+#if defined( PPQ_SIMD )
+// compressed lane indices for every 8-bit mask
+struct compress_table
+{
+  unsigned char index[256][8];
+};
+
+constexpr compress_table make_compress_table()
+{
+  compress_table table{};
+  for( int mask = 0; mask < 256; ++mask )
+  {
+    int num = 0;
+    for( int bit = 0; bit < 8; ++bit )
+      if( mask & (1 << bit) ) table.index[mask][num++] = bit;
+  }
+  return table;
+}
+
+inline constexpr compress_table compress_lut = make_compress_table();
+
+// writes base + index of every set bit of mask to offsets
+// returns the number of set bits
+template< int Lanes >
+inline int compress_offsets( const unsigned mask, const int base,
+                             unsigned char *offsets )
+{
+#if defined( __AVX512F__ )
+  if( Lanes == 16 )
+  {
+    const __m512i index = _mm512_add_epi32(
+      _mm512_set_epi32( 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0 ),
+      _mm512_set1_epi32( base ) );
+    const __m512i compressed = _mm512_maskz_compress_epi32( mask, index );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( offsets ),
+                      _mm512_maskz_cvtepi32_epi8( 0xffff, compressed ) );
+    return __builtin_popcount( mask );
+  }
+#endif
+  // up to 8 lanes: permutation table
+  const __m128i index = _mm_add_epi8(
+    _mm_loadl_epi64( reinterpret_cast<const __m128i*>( compress_lut.index[mask] ) ),
+    _mm_set1_epi8( static_cast<char>( base ) ) );
+  _mm_storel_epi64( reinterpret_cast<__m128i*>( offsets ), index );
+  return __builtin_popcount( mask );
+}
+
+// vectorized comparisons of Lanes keys against a broadcasted pivot
+// less: bit set where elem < pivot, greater: bit set where elem > pivot
+template< class T, class Enable = void >
+struct simd_compare;
+
+#if defined( __AVX512F__ )
+template< class T >
+struct simd_compare< T, typename std::enable_if< std::is_integral<T>::value &&
+                                                 sizeof(T) == 4 >::type >
+{
+  static constexpr int lanes = 16;
+  using reg = __m512i;
+  static reg broadcast( const T pivot ) { return _mm512_set1_epi32( pivot ); }
+  static unsigned less( const T *data, const reg pivot )
+  { return _mm512_cmplt_epi32_mask( _mm512_loadu_si512( data ), pivot ); }
+  static unsigned greater( const T *data, const reg pivot )
+  { return _mm512_cmpgt_epi32_mask( _mm512_loadu_si512( data ), pivot ); }
+};
+
+template< class T >
+struct simd_compare< T, typename std::enable_if< std::is_integral<T>::value &&
+                                                 sizeof(T) == 8 >::type >
+{
+  static constexpr int lanes = 8;
+  using reg = __m512i;
+  static reg broadcast( const T pivot ) { return _mm512_set1_epi64( pivot ); }
+  static unsigned less( const T *data, const reg pivot )
+  { return _mm512_cmplt_epi64_mask( _mm512_loadu_si512( data ), pivot ); }
+  static unsigned greater( const T *data, const reg pivot )
+  { return _mm512_cmpgt_epi64_mask( _mm512_loadu_si512( data ), pivot ); }
+};
+
+template<>
+struct simd_compare< float >
+{
+  static constexpr int lanes = 16;
+  using reg = __m512;
+  static reg broadcast( const float pivot ) { return _mm512_set1_ps( pivot ); }
+  static unsigned less( const float *data, const reg pivot )
+  { return _mm512_cmp_ps_mask( _mm512_loadu_ps( data ), pivot, _CMP_LT_OQ ); }
+  static unsigned greater( const float *data, const reg pivot )
+  { return _mm512_cmp_ps_mask( _mm512_loadu_ps( data ), pivot, _CMP_GT_OQ ); }
+};
+
+template<>
+struct simd_compare< double >
+{
+  static constexpr int lanes = 8;
+  using reg = __m512d;
+  static reg broadcast( const double pivot ) { return _mm512_set1_pd( pivot ); }
+  static unsigned less( const double *data, const reg pivot )
+  { return _mm512_cmp_pd_mask( _mm512_loadu_pd( data ), pivot, _CMP_LT_OQ ); }
+  static unsigned greater( const double *data, const reg pivot )
+  { return _mm512_cmp_pd_mask( _mm512_loadu_pd( data ), pivot, _CMP_GT_OQ ); }
+};
+#else
+template< class T >
+struct simd_compare< T, typename std::enable_if< std::is_integral<T>::value &&
+                                                 sizeof(T) == 4 >::type >
+{
+  static constexpr int lanes = 8;
+  using reg = __m256i;
+  static reg broadcast( const T pivot ) { return _mm256_set1_epi32( pivot ); }
+  static unsigned less( const T *data, const reg pivot )
+  {
+    const __m256i elems = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+    return _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpgt_epi32( pivot, elems ) ) );
+  }
+  static unsigned greater( const T *data, const reg pivot )
+  {
+    const __m256i elems = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+    return _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpgt_epi32( elems, pivot ) ) );
+  }
+};
+
+template< class T >
+struct simd_compare< T, typename std::enable_if< std::is_integral<T>::value &&
+                                                 sizeof(T) == 8 >::type >
+{
+  static constexpr int lanes = 4;
+  using reg = __m256i;
+  static reg broadcast( const T pivot ) { return _mm256_set1_epi64x( pivot ); }
+  static unsigned less( const T *data, const reg pivot )
+  {
+    const __m256i elems = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+    return _mm256_movemask_pd( _mm256_castsi256_pd( _mm256_cmpgt_epi64( pivot, elems ) ) );
+  }
+  static unsigned greater( const T *data, const reg pivot )
+  {
+    const __m256i elems = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data ) );
+    return _mm256_movemask_pd( _mm256_castsi256_pd( _mm256_cmpgt_epi64( elems, pivot ) ) );
+  }
+};
+
+template<>
+struct simd_compare< float >
+{
+  static constexpr int lanes = 8;
+  using reg = __m256;
+  static reg broadcast( const float pivot ) { return _mm256_set1_ps( pivot ); }
+  static unsigned less( const float *data, const reg pivot )
+  { return _mm256_movemask_ps( _mm256_cmp_ps( _mm256_loadu_ps( data ), pivot, _CMP_LT_OQ ) ); }
+  static unsigned greater( const float *data, const reg pivot )
+  { return _mm256_movemask_ps( _mm256_cmp_ps( _mm256_loadu_ps( data ), pivot, _CMP_GT_OQ ) ); }
+};
+
+template<>
+struct simd_compare< double >
+{
+  static constexpr int lanes = 4;
+  using reg = __m256d;
+  static reg broadcast( const double pivot ) { return _mm256_set1_pd( pivot ); }
+  static unsigned less( const double *data, const reg pivot )
+  { return _mm256_movemask_pd( _mm256_cmp_pd( _mm256_loadu_pd( data ), pivot, _CMP_LT_OQ ) ); }
+  static unsigned greater( const double *data, const reg pivot )
+  { return _mm256_movemask_pd( _mm256_cmp_pd( _mm256_loadu_pd( data ), pivot, _CMP_GT_OQ ) ); }
+};
+#endif
+
+// mask of all lanes where the pivot predicate is true
+template< bool Less, class Ops, class T >
+inline unsigned simd_predicate_mask( const T *data, const typename Ops::reg pivot )
+{
+  constexpr unsigned all = ( 1u << Ops::lanes ) - 1;
+  if( Less ) return Ops::less( data, pivot );
+  return ~Ops::greater( data, pivot ) & all;
+}
+
+// vectorized scanner of neutralize_blockwise for simd_predicate
+struct simd_scanner
+{
+  template< bool Want, class FwdIt, class Predicate >
+  static int scan( const FwdIt it, const int size, unsigned char *offsets,
+                   const Predicate &pred )
+  {
+    using T = typename std::iterator_traits<FwdIt>::value_type;
+    using Ops = simd_compare<T>;
+    constexpr bool Less = simd_predicate<Predicate, FwdIt>::less;
+    constexpr unsigned all = ( 1u << Ops::lanes ) - 1;
+    const T *data = &*it;
+    const auto pivot = Ops::broadcast( pred.pivot );
+    int num = 0;
+    int k = 0;
+    for( ; k + Ops::lanes <= size; k += Ops::lanes )
+    {
+      unsigned mask = simd_predicate_mask< Less, Ops >( data + k, pivot );
+      if( !Want ) mask = ~mask & all;
+      num += compress_offsets< Ops::lanes >( mask, k, offsets + num );
+    }
+    for( ; k < size; ++k )
+    {
+      offsets[num] = k;
+      num += ( static_cast<bool>( pred( data[k] ) ) == Want );
+    }
+    return num;
+  }
+
+  template< class FwdIt, class Predicate >
+  static long count( const FwdIt first, const FwdIt last, const Predicate &pred )
+  {
+    using T = typename std::iterator_traits<FwdIt>::value_type;
+    using Ops = simd_compare<T>;
+    constexpr bool Less = simd_predicate<Predicate, FwdIt>::less;
+    const long size = last - first;
+    if( size == 0 ) return 0;
+    const T *data = &*first;
+    const auto pivot = Ops::broadcast( pred.pivot );
+    long num = 0;
+    long k = 0;
+    for( ; k + Ops::lanes <= size; k += Ops::lanes )
+      num += __builtin_popcount( simd_predicate_mask< Less, Ops >( data + k, pivot ) );
+    for( ; k < size; ++k )
+      num += static_cast<bool>( pred( data[k] ) );
+    return num;
+  }
+};
+#endif // PPQ_SIMD
+
+// neutralization kernels, selected per call by the Kernel template parameter
+// of ppartition, quicksort, pquickselect, ...
+// count = number of elements with pred(elem) == true, used by spartition
+// scanning_kernel: two data-dependent scanning loops (Tsigas and Zhang)
+struct scanning_kernel
+{
+  template< class FwdIt, class Predicate >
+  static int neutralize( const FwdIt left_first, const FwdIt left_last,
+                         const FwdIt right_first, const FwdIt right_last,
+                         const Predicate pred )
+  {
+    return ::neutralize( left_first, left_last, right_first, right_last, pred );
+  }
+
+  template< class FwdIt, class Predicate >
+  static long count( const FwdIt first, const FwdIt last, const Predicate pred )
+  {
+    long split = 0;
+    for( auto iter = first; iter < last; ++iter )
+    {
+      if( pred(*iter) ) ++split;
+    }
+    return split;
+  }
+};
+
+// branchless_kernel: offset buffers without data-dependent branches
+// faster for unpredictable predicates, e.g. random keys
+struct branchless_kernel
+{
+  template< class FwdIt, class Predicate >
+  static int neutralize( const FwdIt left_first, const FwdIt left_last,
+                         const FwdIt right_first, const FwdIt right_last,
+                         const Predicate pred )
+  {
+    return neutralize_branchless( left_first, left_last,
+                                  right_first, right_last, pred );
+  }
+
+  template< class FwdIt, class Predicate >
+  static long count( const FwdIt first, const FwdIt last, const Predicate pred )
+  {
+    return scalar_scanner::count( first, last, pred );
+  }
+};
+
+// simd_kernel: vectorized branchless kernel for int32, int64, float and
+// double keys with the pivot predicates of quicksort and pquickselect
+// (std::less), all other predicates use the branchless kernel
+struct simd_kernel
+{
+  template< class FwdIt, class Predicate >
+  static int neutralize( const FwdIt left_first, const FwdIt left_last,
+                         const FwdIt right_first, const FwdIt right_last,
+                         const Predicate pred )
+  {
+#if defined( PPQ_SIMD )
+    if constexpr( simd_predicate<Predicate, FwdIt>::value )
+      return neutralize_blockwise< simd_scanner >( left_first, left_last,
+                                                   right_first, right_last, pred );
+#endif
+    return neutralize_branchless( left_first, left_last,
+                                  right_first, right_last, pred );
+  }
+
+  template< class FwdIt, class Predicate >
+  static long count( const FwdIt first, const FwdIt last, const Predicate pred )
+  {
+#if defined( PPQ_SIMD )
+    if constexpr( simd_predicate<Predicate, FwdIt>::value )
+      return simd_scanner::count( first, last, pred );
+#endif
+    return scalar_scanner::count( first, last, pred );
+  }
+};
+
+// extracts block from the left side of the array
+template< class FwdIt >
+inline void getLeftBlock( const FwdIt first, const FwdIt last,
+                          FwdIt &left_first, FwdIt &left_last,
+                          std::atomic<int> &numRemainingBlocks, std::atomic<int> &i,
+                          const long B )
+{
+  if( 0 < std::atomic_fetch_sub( &numRemainingBlocks, 1 ) )
+  {
+    auto ii = std::atomic_fetch_add( &i, 1 );
+    left_first = first + ii*B;
+    left_last = first + ii*B + B;
+  }
+  else
+  {
+    left_first = last;
+    left_last = last;
+  }
+}
+
+// extracts block from the right side of the array
+template< class FwdIt >
+inline void getRightBlock( const FwdIt first, const FwdIt last,
+                           FwdIt &right_first, FwdIt &right_last,
+                           std::atomic<int> &numRemainingBlocks, std::atomic<int> &j,
+                           const long N, const long B )
+{
+  if( 0 < std::atomic_fetch_sub( &numRemainingBlocks, 1 ) )
+  {
+    auto jj = std::atomic_fetch_add( &j, 1 );
+    right_first = last - N%B - jj*B;
+    right_last = last - N%B - jj*B + B;
+  }
+  else
+  {
+    right_first = last;
+    right_last = last;
+  }
+}
+
+// ignores a finished block, default of neutralize_claimed_blocks
+struct ignore_block
+{
+  template< class FwdIt >
+  void operator()( const FwdIt, const FwdIt ) const {}
+};
+
+// neutralizes blocks claimed from both sides until no block is left
+// only complete blocks are claimed
+// remaining = receives the first element-index of the unfinished block or N
+// right_done = called with every finished right-side block while it is
+//              still in the cache, see block_partitioning3
+template< class Kernel, class FwdIt, class Predicate, class RightDone = ignore_block >
+inline void neutralize_claimed_blocks( const FwdIt first, const FwdIt last,
+                                       const Predicate pred,
+                                       std::atomic<int> &numRemainingBlocks,
+                                       std::atomic<int> &i, std::atomic<int> &j,
+                                       const long B, long &remaining,
+                                       const RightDone &right_done = RightDone{} )
+{
+  const long N = last - first;
+  FwdIt left_first, left_last, right_first, right_last;
+
+  getLeftBlock( first, last, left_first, left_last, numRemainingBlocks, i, B );
+  getRightBlock( first, last, right_first, right_last, numRemainingBlocks, j, N, B );
+  // claimed blocks, only counted for the statistics
+  long claimed = (left_first != last) + (right_first != last);
+
+  while( (left_first != last) && (right_first != last) )
+  {
+    auto result = Kernel::neutralize( left_first, left_last,
+                                      right_first, right_last, pred );
+    if( result%2 == 0 ) // left-side block was obtained
+    {
+      getLeftBlock( first, last, left_first, left_last, numRemainingBlocks, i, B );
+      claimed += (left_first != last);
+    }
+    if( result > 0 ) // right-side block was obtained
+    {
+      right_done( right_first, right_last );
+      getRightBlock( first, last, right_first, right_last, numRemainingBlocks, j, N, B );
+      claimed += (right_first != last);
+    }
+  }
+  ppq::stats_thread_blocks( claimed );
+  remaining = N;
+  if( left_first != last ) // remember left block if not finished
+    remaining = left_first - first;
+  else if( right_first != last ) // remember right block if not finished
+    remaining = right_first - first;
+}
+
+// all processors partition the array blockwise
+// only complete blocks are claimed, the incomplete last block is left to
+// parallel_cleanup
+// first, last = array borders
+// num = number of threads
+// left_blocks = number of blocks claimed from the left side
+// remainingBlocks = remembers first element-index of all remaining blocks
+// B = block size
+template< class Kernel, class FwdIt, class Predicate >
+inline void parallel_phase( const FwdIt first, const FwdIt last,
+                            const Predicate pred, const int num,
+                            long &left_blocks, long *remainingBlocks,
+                            const long B )
+{
+  const long N = last - first;
+  // variables for assigning threads
+  std::atomic<int> numRemainingBlocks( N / B );
+  std::atomic<int> i( 0 );
+  std::atomic<int> j( 1 );
+
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task firstprivate( tid ) shared( i, j, numRemainingBlocks ) if( num > 1 )
+    neutralize_claimed_blocks< Kernel >( first, last, pred, numRemainingBlocks,
+                                         i, j, B, remainingBlocks[tid] );
+  }
+#pragma omp taskwait
+  if( num > 1 ) ppq::stats_add( &ppq::stats::tasks, num );
+  left_blocks = i;
+}
+
+// is faster than quicksort for small arrays
+template< class FwdIt, class Compare = std::less<> >
+inline void insertion_sort( FwdIt first, FwdIt last, const Compare cmp = Compare{} )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  int i = 1;
+  while( i < (last - first) )
+  {
+    T x = std::move( *(first + i) );
+    int j = i-1;
+    while( ( j >= 0 ) && cmp( x, *(first + j) ) )
+    {
+      *(first + j + 1) = std::move( *(first + j) );
+      --j;
+    }
+    *(first + j + 1) = std::move( x );
+    ++i;
+  }
+}
+
+// partitions an array single-threaded
+template< class Kernel = scanning_kernel, class FwdIt, class Predicate >
+constexpr FwdIt spartition( const FwdIt first, const FwdIt last,
+                            const Predicate pred )
+{
+  // finds splitting point
+  const long split = Kernel::count( first, last, pred );
+  // partitions array and returns first element of right-side group
+  Kernel::neutralize( first, first+split, first+split, last, pred );
+  return first+split;
+}
+
+// swapps two blocks
+template< class FwdIt >
+inline void swapBlocks( const FwdIt left_first, const FwdIt left_last,
+                        const FwdIt right_first, const FwdIt right_last )
+{
+  if( right_first != left_first )
+  {
+    auto left_it = left_first;
+    auto right_it = right_first;
+    while( (left_it < left_last) && (right_it < right_last) )
+    {
+      std::iter_swap( left_it, right_it );
+      left_it++;
+      right_it++;
+    }
+  }
+}
+
+// state of a block after neutralization
+enum block_state : signed char { block_mixed, block_true, block_false };
+
+// partitions the remaining blocks after parallel_phase in parallel
+// 1. the remaining blocks are neutralized pairwise in rounds, the outermost
+//    pairs first, until at most one mixed block is left
+// 2. every true block right of the final border is swapped with a not-true
+//    block left of it, one task per pair
+// 3. the mixed block is swapped to the border and partitioned
+// only the remaining blocks can be on the wrong side, so the swap plan has
+// O(num) entries and the serial work is O(B) for any number of threads
+// first, last = array borders
+// num = number of threads in previous parallel_phase
+// left_blocks = number of blocks claimed from the left side
+// remainingBlocks = remembers first element-index of all remaining blocks
+// B = block size
+template< class Kernel, class FwdIt, class Predicate >
+inline FwdIt parallel_cleanup( const FwdIt first, const FwdIt last,
+                               const Predicate pred, const int num,
+                               const long left_blocks, const long *remainingBlocks,
+                               const long B )
+{
+  const long N = last - first;
+  const long full_blocks = N / B;
+  auto block_first = [first, B]( const long block ) { return first + block * B; };
+  auto block_last = [first, last, N, B]( const long block )
+  {
+    return ( (block + 1) * B < N ) ? first + (block + 1) * B : last;
+  };
+
+  // remaining blocks with their state, sorted by position
+  // the incomplete last block was not claimed and remains always, one more
+  // block may be inserted for it below
+  ppq::scratch_frame frame;
+  ppq::scratch_vector< std::pair< long, block_state > > blocks( frame, num + 2 );
+  for( int tid = 0; tid < num; ++tid )
+    if( remainingBlocks[tid] != N )
+      blocks.push_back( { remainingBlocks[tid] / B, block_mixed } );
+  if( N % B != 0 ) blocks.push_back( { full_blocks, block_mixed } );
+  std::sort( blocks.begin(), blocks.end() );
+  ppq::stats_partition( num, blocks.size() );
+  ppq::stats_timer timer( ppq::neutralization_time );
+  // blocks which are not remaining kept the side they were claimed from
+  auto state = [&blocks, left_blocks]( const long block )
+  {
+    const auto it = std::lower_bound( blocks.begin(), blocks.end(),
+                                      std::make_pair( block, block_mixed ) );
+    if( it != blocks.end() && it->first == block ) return it->second;
+    return block < left_blocks ? block_true : block_false;
+  };
+
+  // 1. neutralization rounds, every pair finishes at least one block
+  ppq::scratch_vector<long> mixed( frame, blocks.size() );
+  for( std::size_t k = 0; k < blocks.size(); ++k ) mixed.push_back( k );
+  while( mixed.size() > 1 )
+  {
+    const long pairs = mixed.size() / 2;
+    for( long k = 0; k < pairs; ++k )
+    {
+#pragma omp task firstprivate( k ) shared( blocks, mixed ) if( num > 1 && pairs > 1 )
+{
+      auto &left = blocks[ mixed[k] ];
+      auto &right = blocks[ mixed[mixed.size() - 1 - k] ];
+      const int result = Kernel::neutralize( block_first( left.first ), block_last( left.first ),
+                                             block_first( right.first ), block_last( right.first ),
+                                             pred );
+      if( result%2 == 0 ) left.second = block_true;
+      if( result > 0 ) right.second = block_false;
+}// end omp task
+    }
+#pragma omp taskwait
+    std::size_t still_mixed = 0;
+    for( const long k : mixed )
+      if( blocks[k].second == block_mixed ) mixed[still_mixed++] = k;
+    mixed.resize( still_mixed );
+  }
+  long mixed_block = mixed.empty() ? -1 : blocks[ mixed[0] ].first;
+
+  // an incomplete mixed block cannot be swapped with complete blocks,
+  // its true elements are exchanged with a complete false block instead
+  if( mixed_block == full_blocks )
+  {
+    long other = -1;
+    for( long block = left_blocks; block < full_blocks && other < 0; ++block )
+      if( state( block ) == block_false ) other = block;
+    for( std::size_t k = 0; k < blocks.size() && other < 0; ++k )
+      if( blocks[k].second == block_false && blocks[k].first < full_blocks )
+        other = blocks[k].first;
+    // no false block: all complete blocks are true
+    if( other < 0 )
+    {
+      timer.next( ppq::final_partition_time );
+      return spartition< Kernel >( block_first( full_blocks ), last, pred );
+    }
+
+    const int result = Kernel::neutralize( block_first( other ), block_last( other ),
+                                           block_first( full_blocks ), last, pred );
+    auto it = std::lower_bound( blocks.begin(), blocks.end(),
+                                std::make_pair( other, block_mixed ) );
+    if( it == blocks.end() || it->first != other )
+      it = blocks.insert( it, { other, block_mixed } );
+    it->second = ( result%2 == 0 ) ? block_true : block_mixed;
+    blocks.back().second = block_false;
+    mixed_block = ( result%2 == 0 ) ? -1 : other;
+  }
+
+  // 2. block-swap plan
+  // the final border lies behind the last true block
+  timer.next( ppq::swapping_time );
+  long true_blocks = left_blocks;
+  for( const auto &block : blocks )
+  {
+    if( block.first < left_blocks && block.second != block_true ) --true_blocks;
+    if( block.first >= left_blocks && block.second == block_true ) ++true_blocks;
+  }
+  // wrong_left = not-true blocks left of the border, wrong_right = true
+  // blocks right of it, between left_blocks and the border all blocks are
+  // checked, elsewhere only the remaining ones
+  // both lists have the same length, at most the number of remaining blocks
+  const long lo = std::min( left_blocks, true_blocks );
+  const long hi = std::max( left_blocks, true_blocks );
+  ppq::scratch_vector<long> wrong_left( frame, blocks.size() );
+  ppq::scratch_vector<long> wrong_right( frame, blocks.size() );
+  auto check = [&]( const long block, const block_state s )
+  {
+    if( block < true_blocks && s != block_true ) wrong_left.push_back( block );
+    if( block >= true_blocks && s == block_true ) wrong_right.push_back( block );
+  };
+  for( long block = lo; block < hi; ++block ) check( block, state( block ) );
+  for( const auto &block : blocks )
+    if( block.first < lo || block.first >= hi ) check( block.first, block.second );
+
+  for( std::size_t k = 0; k < wrong_left.size(); ++k )
+  {
+#pragma omp task firstprivate( k ) shared( wrong_left, wrong_right ) if( num > 1 )
+    swapBlocks( block_first( wrong_left[k] ), block_last( wrong_left[k] ),
+                block_first( wrong_right[k] ), block_last( wrong_right[k] ) );
+    if( wrong_left[k] == mixed_block ) mixed_block = wrong_right[k];
+  }
+#pragma omp taskwait
+  if( num > 1 ) ppq::stats_add( &ppq::stats::tasks, wrong_left.size() );
+
+  // 3. the mixed block is swapped to the border and partitioned
+  if( mixed_block < 0 ) return block_first( true_blocks );
+  timer.next( ppq::final_partition_time );
+  swapBlocks( block_first( mixed_block ), block_last( mixed_block ),
+              block_first( true_blocks ), block_last( true_blocks ) );
+  return spartition< Kernel >( block_first( true_blocks ), block_last( true_blocks ), pred );
+}
+
+// NUMA mode
+// on machines with several NUMA nodes the blocks of large arrays are split
+// into one segment per node, every segment has its own claim counters in
+// its own cache line
+// 1. the threads claim blocks of the segment of their own node first and
+//    blocks of other segments only when their own segment runs out
+// 2. every segment is cleaned up on its own
+// 3. the true elements behind the final border are swapped with the false
+//    elements in front of it, the pieces are claimed by all threads
+// arrays initialized by pfirst_touch have the pages of segment k on node k
+// the topology is read from sysfs, PPQ_NO_NUMA disables the NUMA mode
+
+// arrays smaller than this are partitioned without the NUMA mode
+constexpr long numa_partition_threshold = 1L << 18;
+
+// number of NUMA nodes and the node of every cpu
+struct numa_topology
+{
+  int nodes = 1;
+  // empty if unknown, the threads are then spread over the nodes by number
+  std::vector<int> cpu_node;
+};
+
+// parses a sysfs cpu list like "0-3,8-11" and sets the cpus to node
+inline void read_cpu_list( const std::string &list, const int node,
+                           std::vector<int> &cpu_node )
+{
+  std::size_t pos = 0;
+  while( pos < list.size() )
+  {
+    const std::size_t end = std::min( list.find( ',', pos ), list.size() );
+    const std::string range = list.substr( pos, end - pos );
+    const std::size_t dash = range.find( '-' );
+    const int lo = std::atoi( range.c_str() );
+    const int hi = ( dash == std::string::npos ) ? lo : std::atoi( range.c_str() + dash + 1 );
+    if( hi >= static_cast<int>( cpu_node.size() ) ) cpu_node.resize( hi + 1, 0 );
+    for( int cpu = lo; cpu <= hi; ++cpu ) cpu_node[cpu] = node;
+    pos = end + 1;
+  }
+}
+
+// reads the nodes from /sys/devices/system/node
+inline numa_topology detect_numa_topology()
+{
+  numa_topology topology;
+#if !defined( PPQ_NO_NUMA )
+  constexpr int max_nodes = 64;
+  for( int node = 0; node < max_nodes; ++node )
+  {
+    std::ifstream file( "/sys/devices/system/node/node" + std::to_string( node ) + "/cpulist" );
+    if( !file ) continue;
+    std::string list;
+    file >> list;
+    read_cpu_list( list, node, topology.cpu_node );
+    topology.nodes = node + 1;
+  }
+#endif
+  return topology;
+}
+
+// topology of the machine, detected at the first use
+// can be changed before the first parallel call, nodes = 1 disables the
+// NUMA mode
+inline numa_topology &numa()
+{
+  static numa_topology topology = detect_numa_topology();
+  return topology;
+}
+
+// node of the cpu the calling thread runs on
+inline int current_numa_node()
+{
+  const numa_topology &topology = numa();
+#if defined( __linux__ )
+  const int cpu = sched_getcpu();
+  if( cpu >= 0 && cpu < static_cast<int>( topology.cpu_node.size() ) )
+    return topology.cpu_node[cpu];
+#endif
+  return omp_get_thread_num() % topology.nodes;
+}
+
+// whether ppartition and the work-stealing scheduler use the NUMA mode
+inline bool numa_mode( const long N, const int num )
+{
+  return num > 1 && numa().nodes > 1 && N >= numa_partition_threshold;
+}
+
+// first element-index of segment s of n elements, segment nodes is the end
+// the borders are multiples of B
+inline long numa_segment( const int s, const int nodes, const long n, const long B )
+{
+  return ( s == nodes ) ? n : ( n / B ) * s / nodes * B;
+}
+
+// blockwise partitioning with one segment per node
+// work and exchange can be called concurrently by different slots
+// the bookkeeping is taken from frame, so the partitioning lives in the
+// scope of the frame on the thread which creates it
+template< class Kernel, class FwdIt, class Predicate >
+class numa_partitioning
+{
+public:
+  numa_partitioning( ppq::scratch_frame &frame, const FwdIt first, const FwdIt last,
+                     const Predicate pred, const int slots, const long B )
+    : first( first ), pred( pred ), nodes( numa().nodes ), slots( slots ), B( B ),
+      segments( frame.take<segment>( nodes ) ),
+      remainingBlocks( frame.take<long>( nodes * slots ) ),
+      wrong_false( frame, nodes ), wrong_true( frame, nodes )
+  {
+    const long N = last - first;
+    for( int s = 0; s < nodes; ++s )
+    {
+      auto &segment = segments[s];
+      segment.begin = numa_segment( s, nodes, N, B );
+      segment.end = numa_segment( s + 1, nodes, N, B );
+      const long length = segment.end - segment.begin;
+      segment.numRemainingBlocks = length / B;
+      for( int slot = 0; slot < slots; ++slot )
+        remainingBlocks[s * slots + slot] = length;
+    }
+  }
+
+  // 1. neutralizes blocks, the segment of the own node first
+  void work( const int slot )
+  {
+    const int node = current_numa_node();
+    for( int k = 0; k < nodes; ++k )
+    {
+      const int s = ( node + k ) % nodes;
+      auto &segment = segments[s];
+      neutralize_claimed_blocks< Kernel >( first + segment.begin, first + segment.end, pred,
+                                           segment.numRemainingBlocks, segment.i,
+                                           segment.j, B,
+                                           remainingBlocks[s * slots + slot] );
+    }
+  }
+
+  // 2. cleans up the segments and plans the exchange, called by the thread
+  // which created the partitioning
+  void prepare_exchange()
+  {
+    ppq::scratch_frame frame;
+    long *borders = frame.take<long>( nodes );
+    long border = 0;
+    for( int s = 0; s < nodes; ++s )
+    {
+      auto &segment = segments[s];
+      borders[s] = parallel_cleanup< Kernel >( first + segment.begin, first + segment.end,
+                                               pred, slots, segment.i.load(),
+                                               remainingBlocks + s * slots, B ) - first;
+      border += borders[s] - segment.begin;
+    }
+    final_border = border;
+
+    // false parts in front of the border and true parts behind it, both
+    // hold the same number of elements
+    for( int s = 0; s < nodes; ++s )
+    {
+      if( borders[s] < border )
+      {
+        wrong_false.push_back( { borders[s], std::min( segments[s].end, border ) } );
+        misplaced += length_of( wrong_false.back() );
+      }
+      if( borders[s] > border )
+        wrong_true.push_back( { std::max( segments[s].begin, border ), borders[s] } );
+    }
+  }
+
+  // 3. swaps the claimed pieces, piece k = the elements [k B, (k + 1) B) of
+  // the false parts with the same elements of the true parts
+  void exchange()
+  {
+    for( long k = next_piece++; k * B < misplaced; k = next_piece++ )
+    {
+      long offset = k * B;
+      const long end = std::min( misplaced, offset + B );
+      // parts f and t and the elements in front of them
+      std::size_t f = 0, t = 0;
+      long in_front_f = 0, in_front_t = 0;
+      while( offset < end )
+      {
+        for( ; in_front_f + length_of( wrong_false[f] ) <= offset; ++f )
+          in_front_f += length_of( wrong_false[f] );
+        for( ; in_front_t + length_of( wrong_true[t] ) <= offset; ++t )
+          in_front_t += length_of( wrong_true[t] );
+        const long left = wrong_false[f].first + ( offset - in_front_f );
+        const long right = wrong_true[t].first + ( offset - in_front_t );
+        const long length = std::min( { end - offset, wrong_false[f].second - left,
+                                        wrong_true[t].second - right } );
+        std::swap_ranges( first + left, first + (left + length), first + right );
+        offset += length;
+      }
+    }
+  }
+
+  // first element of the right-side group
+  FwdIt border() const { return first + final_border; }
+
+  // one cache line per segment, [begin, end) relative to first
+  struct alignas( 64 ) segment
+  {
+    long begin, end;
+    std::atomic<int> numRemainingBlocks{ 0 };
+    std::atomic<int> i{ 0 };
+    std::atomic<int> j{ 1 };
+  };
+
+private:
+  static long length_of( const std::pair<long, long> &part ) { return part.second - part.first; }
+
+  const FwdIt first;
+  const Predicate pred;
+  const int nodes;
+  const int slots;
+  const long B;
+  segment *segments;
+  long *remainingBlocks;
+  ppq::scratch_vector< std::pair<long, long> > wrong_false, wrong_true;
+  long misplaced = 0;
+  std::atomic<long> next_piece{ 0 };
+  long final_border = 0;
+};
+
+namespace ppq
+{
+inline std::size_t numa_scratch_bytes( const int num )
+{
+  const std::size_t nodes = numa().nodes;
+  if( nodes == 1 ) return 0;
+  // segments, remaining blocks, false and true parts, borders and the
+  // alignment
+  using segment = numa_partitioning< scanning_kernel, long*, bool(*)( long ) >::segment;
+  return nodes * sizeof( segment ) + alignof( segment ) + nodes * num * sizeof( long ) +
+         2 * nodes * sizeof( std::pair<long, long> ) + nodes * sizeof( long ) +
+         5 * alignof( std::max_align_t );
+}
+} // namespace ppq
+
+// initializes [first, last) with value( i ) for element i in parallel, so
+// that the pages of segment k of the NUMA mode are first touched by the
+// threads of node k, the threads of a node share its segment
+// first, last = memory not touched yet, e.g. new T[n] of a trivial type
+// segments of nodes without threads are shared by all threads
+template< class FwdIt, class Value >
+void pfirst_touch( const FwdIt first, const FwdIt last, const Value value,
+                   const int num = omp_get_max_threads() )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  const long n = std::distance( first, last );
+  const long B = block_size< 0, T >();
+  const int nodes = numa().nodes;
+  std::vector<int> thread_node( num, -1 );
+  team_run( num, [&]()
+  {
+    const int tid = omp_get_thread_num();
+    const int threads = omp_get_num_threads();
+    thread_node[tid] = current_numa_node();
+#pragma omp barrier
+    for( int s = 0; s < nodes; ++s )
+    {
+      // rank of the thread among the threads of node s
+      int rank = -1, count = 0;
+      for( int t = 0; t < threads; ++t )
+        if( thread_node[t] == s )
+        {
+          if( t == tid ) rank = count;
+          ++count;
+        }
+      if( count == 0 )
+      {
+        rank = tid;
+        count = threads;
+      }
+      if( rank < 0 ) continue;
+      const long begin = numa_segment( s, nodes, n, B );
+      const long length = numa_segment( s + 1, nodes, n, B ) - begin;
+      for( long i = begin + length * rank / count; i < begin + length * (rank + 1) / count; ++i )
+        *(first + i) = value( i );
+    }
+  } );
+}
+
+// parallel phase and parallel cleanup of ppartition
+// must be called inside a parallel region
+template< class Kernel, class FwdIt, class Predicate >
+inline FwdIt partition_phases( const FwdIt first, const FwdIt last,
+                               const Predicate pred, const int num,
+                               long *remainingBlocks, const long B )
+{
+  if( numa_mode( last - first, num ) )
+  {
+    ppq::scratch_frame frame;
+    numa_partitioning< Kernel, FwdIt, Predicate > partitioning( frame, first, last, pred,
+                                                                num, B );
+    ppq::stats_timer timer( ppq::parallel_phase_time );
+    for( int tid = 0; tid < num; ++tid )
+    {
+#pragma omp task firstprivate( tid ) shared( partitioning )
+      partitioning.work( tid );
+    }
+#pragma omp taskwait
+    timer.next( ppq::neutralization_time );
+    partitioning.prepare_exchange();
+    timer.next( ppq::swapping_time );
+    for( int tid = 0; tid < num; ++tid )
+    {
+#pragma omp task shared( partitioning )
+      partitioning.exchange();
+    }
+#pragma omp taskwait
+    ppq::stats_add( &ppq::stats::tasks, 2 * num );
+    ppq::stats_partition( num, 0 );
+    return partitioning.border();
+  }
+  long left_blocks;
+  // all processors partition the array blockwise
+  {
+    const ppq::stats_timer timer( ppq::parallel_phase_time );
+    parallel_phase< Kernel >( first, last, pred, num, left_blocks, remainingBlocks, B );
+  }
+  // the remaining blocks are partitioned and moved in parallel
+  return parallel_cleanup< Kernel >( first, last, pred, num, left_blocks,
+                                     remainingBlocks, B );
+}
+
+// combines previous parts to a parallel partioner
+// BlockSize = elements per block, 0 selects the block size policy default
+// Kernel = neutralization kernel, scanning_kernel or branchless_kernel
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Predicate >
+constexpr FwdIt ppartition( const FwdIt first, const FwdIt last,
+                            const Predicate pred,
+                            const int num = omp_get_max_threads(),
+                            const bool omp_parallel_active = false )
+{
+  const long B = block_size< BlockSize,
+                             typename std::iterator_traits<FwdIt>::value_type >();
+  if( omp_parallel_active )
+  {
+    // here, every processors inserts its remaining block after the parallel_phase
+    ppq::scratch_frame frame;
+    long *remainingBlocks = frame.take<long>( num );
+    return partition_phases< Kernel >( first, last, pred, num, remainingBlocks, B );
+  }
+  FwdIt middle = first;
+  team_run( num, [&]()
+  {
+    ppq::reserve_scratch( ppq::partition_scratch_bytes( num ) );
+#pragma omp single
+    {
+      ppq::scratch_frame frame;
+      long *remainingBlocks = frame.take<long>( num );
+      middle = partition_phases< Kernel >( first, last, pred, num, remainingBlocks, B );
+    }
+  } );
+  return middle;
+}
+
+// pstable_partition: parallel stable partition
+// every thread moves the elements of one chunk into the buffer, the true
+// elements from the front and the false elements from the back, the
+// positions in the result follow from a prefix sum over the chunk counts
+
+// arrays smaller than this are partitioned by one thread
+constexpr long stable_partition_threshold = 4096;
+
+// reverses [first, first+n), called by every thread of the team
+template< class FwdIt >
+inline void team_reverse( const FwdIt first, const long n )
+{
+#pragma omp for schedule( static )
+  for( long i = 0; i < n / 2; ++i )
+    std::iter_swap( first + i, first + (n - 1 - i) );
+}
+
+// partitions [first, last) stably without a buffer, n = length
+// O(n log n) moves by rotating the partitioned halves
+template< class FwdIt, class Predicate >
+inline FwdIt stable_partition_rotate( const FwdIt first, const FwdIt last,
+                                      const Predicate pred, const long n )
+{
+  if( n == 0 ) return first;
+  if( n == 1 ) return pred( *first ) ? last : first;
+  const FwdIt mid = first + n / 2;
+  const FwdIt left = stable_partition_rotate( first, mid, pred, n / 2 );
+  const FwdIt right = stable_partition_rotate( mid, last, pred, n - n / 2 );
+  return std::rotate( left, mid, right );
+}
+
+// parallel stable partition, the buffer of at least n elements is returned
+// by get_buffer( n ) on one thread of the team, so a buffer of the context
+// is taken while the context runs this call
+template< class FwdIt, class Predicate, class GetBuffer >
+FwdIt stable_partition_team( const FwdIt first, const FwdIt last,
+                             const Predicate pred, const GetBuffer &get_buffer,
+                             const int num )
+{
+  const long n = std::distance( first, last );
+  // counts[t] = true elements of chunk t, after the prefix sum the number of
+  // true elements in front of chunk t
+  std::vector<long> counts( num );
+  long total = 0;
+  typename std::iterator_traits<FwdIt>::value_type *buffer = nullptr;
+
+  team_run( n < stable_partition_threshold ? 1 : num, [&]()
+  {
+#pragma omp single
+    buffer = get_buffer( n );
+    const int tid = omp_get_thread_num();
+    const int threads = omp_get_num_threads();
+    const long begin = n * tid / threads;
+    const long end = n * (tid + 1) / threads;
+    long t = begin, f = end;
+    for( long i = begin; i < end; ++i )
+    {
+      auto& x = first[i];
+      if( pred( x ) ) buffer[t++] = std::move( x );
+      else buffer[--f] = std::move( x );
+    }
+    counts[tid] = t - begin;
+#pragma omp barrier
+#pragma omp single
+    {
+      for( int i = 0; i < threads; ++i )
+      {
+        const long c = counts[i];
+        counts[i] = total;
+        total += c;
+      }
+    }
+    // true elements in order, false elements were stored reversed
+    std::move( buffer + begin, buffer + t, first + counts[tid] );
+    std::move( std::make_reverse_iterator( buffer + end ),
+               std::make_reverse_iterator( buffer + f ),
+               first + total + ( begin - counts[tid] ) );
+  } );
+  return first + total;
+}
+
+// parallel stable partition with a buffer given by the caller
+// buffer = at least last - first elements, used as scratch space
+// num = number of threads
+// returns the first element of the right-side group like ppartition
+template< class FwdIt, class Predicate >
+FwdIt pstable_partition( const FwdIt first, const FwdIt last,
+                         const Predicate pred,
+                         typename std::iterator_traits<FwdIt>::value_type *buffer,
+                         const int num = omp_get_max_threads() )
+{
+  return stable_partition_team( first, last, pred,
+                                [buffer]( const long ) { return buffer; }, num );
+}
+
+// parallel stable partition
+// allocates a buffer of last - first elements, the value type has to be
+// default constructible
+// the buffer is default-initialized, so its pages are first touched in
+// parallel by the scatter instead of being zeroed by one thread
+template< class FwdIt, class Predicate >
+FwdIt pstable_partition( const FwdIt first, const FwdIt last,
+                         const Predicate pred,
+                         const int num = omp_get_max_threads() )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  std::unique_ptr<T[]> buffer( new T[ std::distance( first, last ) ] );
+  return pstable_partition( first, last, pred, buffer.get(), num );
+}
+
+// parallel stable partition without a buffer (reduced-memory mode)
+// every thread partitions its chunk by rotations, then neighbouring chunks
+// are merged in log(num) rounds by rotating the false part of the left chunk
+// with the true part of the right chunk
+// O(n log n) moves instead of 2n, but no additional memory
+template< class FwdIt, class Predicate >
+FwdIt pstable_partition_inplace( const FwdIt first, const FwdIt last,
+                                 const Predicate pred,
+                                 const int num = omp_get_max_threads() )
+{
+  const long n = std::distance( first, last );
+  // per chunk: first false element and end of the chunk
+  std::vector<long> mids( num ), ends( num );
+
+  team_run( n < stable_partition_threshold ? 1 : num, [&]()
+  {
+    const int tid = omp_get_thread_num();
+    const int threads = omp_get_num_threads();
+    const long begin = n * tid / threads;
+    const long end = n * (tid + 1) / threads;
+    mids[tid] = stable_partition_rotate( first + begin, first + end, pred,
+                                         end - begin ) - first;
+    ends[tid] = end;
+#pragma omp barrier
+    for( int step = 1; step < threads; step *= 2 )
+    {
+      for( int i = 0; i + step < threads; i += 2 * step )
+      {
+        // rotate [mids[i], ends[i]) and [ends[i], mids[i+step])
+        // by three reversals, each one shared by the team
+        const long a = ends[i] - mids[i];
+        const long b = mids[i + step] - ends[i];
+        if( a == 0 || b == 0 ) continue;
+        team_reverse( first + mids[i], a );
+        team_reverse( first + ends[i], b );
+        team_reverse( first + mids[i], a + b );
+      }
+#pragma omp barrier
+#pragma omp single
+      for( int i = 0; i + step < threads; i += 2 * step )
+      {
+        mids[i] += mids[i + step] - ends[i];
+        ends[i] = ends[i + step];
+      }
+    }
+  } );
+  return first + mids[0];
+}
+
+// multiway block partitioning (IPS4o, Axtmann, Witt, Ferizovic and Sanders)
+// distributes the elements of an array to k buckets in one pass
+// 1. local classification: the tasks claim blocks like parallel_phase,
+//    move the elements into one buffer block per bucket and write full
+//    buffer blocks back into already read blocks
+// 2. empty blocks are moved behind the full blocks of every bucket region
+// 3. block permutation: the full blocks are swapped into their bucket region
+// 4. cleanup: the partially filled buffers are written into the gaps
+//    at the bucket borders
+// the value type has to be default constructible
+
+// packs the write and read pointer of a bucket region into one atomic
+constexpr unsigned long long pack_pointers( const long w, const long r )
+{
+  return ( static_cast<unsigned long long>( w ) << 32 ) |
+         static_cast<unsigned long long>( r );
+}
+
+// shared state of multiway_partition
+// first, n = array
+// classify = returns the bucket of an element
+// k = number of buckets, b = elements per block, num = number of tasks
+template< class FwdIt, class Classifier >
+struct multiway_state
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+
+  const FwdIt first;
+  const long n;
+  const Classifier &classify;
+  const int k;
+  const long b;
+  const int num;
+  // number of complete blocks, blocks including an incomplete last block
+  const long slots;
+  const long claimable;
+  std::atomic<long> next_block;
+  std::atomic<int> next_bucket;
+  // full[slot] = 1 if a block of one bucket was written to the slot
+  std::vector<unsigned char> full;
+  // per task: one buffer block per bucket, their fill level and the number
+  // of full blocks written per bucket
+  std::vector< std::vector<T> > buffers;
+  std::vector< std::vector<long> > fill;
+  std::vector< std::vector<long> > written;
+  // per bucket: first element, first slot of the region, full blocks
+  std::vector<long> bucket_begin;
+  std::vector<long> region_begin;
+  std::vector<long> bucket_blocks;
+  // per bucket: write and read pointer, number of blocks being read
+  std::unique_ptr< std::atomic<unsigned long long>[] > pointers;
+  std::unique_ptr< std::atomic<int>[] > reading;
+  // takes the block written behind the end of the array
+  std::vector<T> overflow;
+  // per bucket: elements of the last block reaching into the next bucket
+  std::vector< std::vector<T> > saved;
+
+  multiway_state( const FwdIt first_, const long n_, const Classifier &classify_,
+                  const int k_, const long b_, const int num_ )
+    : first( first_ ), n( n_ ), classify( classify_ ), k( k_ ), b( b_ ),
+      num( num_ ), slots( n_ / b_ ), claimable( (n_ + b_ - 1) / b_ ),
+      next_block( 0 ), next_bucket( 0 ), full( n_ / b_, 0 ),
+      buffers( num_ ), fill( num_ ), written( num_ ),
+      bucket_begin( k_ + 1 ), region_begin( k_ + 1 ), bucket_blocks( k_ ),
+      pointers( new std::atomic<unsigned long long>[k_] ),
+      reading( new std::atomic<int>[k_] ), saved( k_ )
+  {}
+
+  // moves a block of b elements
+  template< class InIt, class OutIt >
+  static void move_block( const InIt from, const long size, const OutIt to )
+  {
+    std::move( from, from + size, to );
+  }
+
+  // 1. local classification of task tid
+  void classify_locally( const int tid )
+  {
+    auto &buffer = buffers[tid];
+    auto &fill_ = fill[tid];
+    auto &written_ = written[tid];
+    buffer.resize( k * b );
+    fill_.assign( k, 0 );
+    written_.assign( k, 0 );
+    // claimed complete blocks, the first write_index ones are written
+    std::vector<long> claimed;
+    std::size_t write_index = 0;
+
+    long block;
+    while( (block = std::atomic_fetch_add( &next_block, 1L )) < claimable )
+    {
+      const long block_first = block * b;
+      const long block_last = ( block_first + b < n ) ? block_first + b : n;
+      if( block < slots ) claimed.push_back( block );
+
+      for( long e = block_first; e < block_last; ++e )
+      {
+        const int bucket = classify( *(first + e) );
+        T *bucket_buffer = buffer.data() + bucket * b;
+        bucket_buffer[fill_[bucket]++] = std::move( *(first + e) );
+        // a full buffer block is written into the oldest read block
+        if( fill_[bucket] == b )
+        {
+          const long slot = claimed[write_index++];
+          move_block( bucket_buffer, b, first + slot * b );
+          full[slot] = 1;
+          written_[bucket]++;
+          fill_[bucket] = 0;
+        }
+      }
+    }
+  }
+
+  // computes the bucket borders and the block regions (sequential)
+  void compute_borders()
+  {
+    bucket_begin[0] = 0;
+    for( int i = 0; i < k; ++i )
+    {
+      long size = 0;
+      long blocks = 0;
+      for( int tid = 0; tid < num; ++tid )
+      {
+        size += written[tid][i] * b + fill[tid][i];
+        blocks += written[tid][i];
+      }
+      bucket_begin[i+1] = bucket_begin[i] + size;
+      bucket_blocks[i] = blocks;
+    }
+    // regions start at the first block border inside the bucket
+    for( int i = 0; i <= k; ++i )
+      region_begin[i] = ( bucket_begin[i] + b - 1 ) / b;
+    next_bucket = 0;
+  }
+
+  // 2. moves the full blocks of every bucket region to its front
+  void move_empty_blocks()
+  {
+    int i;
+    while( (i = std::atomic_fetch_add( &next_bucket, 1 )) < k )
+    {
+      const long region_first = region_begin[i];
+      const long region_last = ( region_begin[i+1] < slots ) ? region_begin[i+1] : slots;
+      long lo = region_first;
+      long hi = region_last - 1;
+      while( true )
+      {
+        while( lo <= hi && full[lo] ) ++lo;
+        while( hi >= lo && !full[hi] ) --hi;
+        if( lo >= hi ) break;
+        move_block( first + hi * b, b, first + lo * b );
+        full[lo] = 1;
+        full[hi] = 0;
+      }
+      pointers[i] = pack_pointers( region_first, lo );
+      reading[i] = 0;
+    }
+  }
+
+  // claims the last unread block of a bucket region
+  bool pop_block( const int bucket, long &slot )
+  {
+    std::atomic_fetch_add( &reading[bucket], 1 );
+    auto p = pointers[bucket].load();
+    while( true )
+    {
+      const long w = p >> 32;
+      const long r = p & 0xFFFFFFFFull;
+      if( r <= w )
+      {
+        std::atomic_fetch_sub( &reading[bucket], 1 );
+        return false;
+      }
+      if( pointers[bucket].compare_exchange_weak( p, pack_pointers( w, r - 1 ) ) )
+      {
+        slot = r - 1;
+        return true;
+      }
+    }
+  }
+
+  // claims the next slot to write of a bucket region
+  // returns true if the slot still holds an unread block
+  bool push_block( const int bucket, long &slot )
+  {
+    const auto p = std::atomic_fetch_add( &pointers[bucket], 1ull << 32 );
+    const long w = p >> 32;
+    const long r = p & 0xFFFFFFFFull;
+    slot = w;
+    return w < r;
+  }
+
+  // 3. block permutation of task tid
+  void permute_blocks( const int tid )
+  {
+    std::vector<T> swap_buffer( 2 * b );
+    T *current = swap_buffer.data();
+    T *other = swap_buffer.data() + b;
+    // every task starts at another bucket
+    const int start = static_cast<int>( static_cast<long>( tid ) * k / num );
+
+    for( int c = 0; c < k; ++c )
+    {
+      const int bucket = ( start + c ) % k;
+      long slot;
+      while( pop_block( bucket, slot ) )
+      {
+        move_block( first + slot * b, b, current );
+        std::atomic_fetch_sub( &reading[bucket], 1 );
+        // swaps the block into its region until an empty slot is hit
+        while( true )
+        {
+          const int dest = classify( *current );
+          long dest_slot;
+          if( push_block( dest, dest_slot ) )
+          {
+            move_block( first + dest_slot * b, b, other );
+            move_block( current, b, first + dest_slot * b );
+            std::swap( current, other );
+          }
+          else
+          {
+            // the slot might still be read by another task
+            while( reading[dest].load() > 0 ) {}
+            if( dest_slot < slots )
+              move_block( current, b, first + dest_slot * b );
+            else
+            {
+              overflow.resize( b );
+              move_block( current, b, overflow.begin() );
+            }
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  // 4a. saves the elements of the last block of a bucket which reach
+  //     into the next bucket
+  void save_overflow()
+  {
+    int i;
+    while( (i = std::atomic_fetch_add( &next_bucket, 1 )) < k )
+    {
+      if( bucket_blocks[i] == 0 ) continue;
+      const long last_slot = region_begin[i] + bucket_blocks[i] - 1;
+      const long written_last = ( last_slot + 1 ) * b;
+      const long bucket_last = bucket_begin[i+1];
+      if( last_slot < slots )
+      {
+        if( written_last > bucket_last )
+          saved[i].assign( std::make_move_iterator( first + bucket_last ),
+                           std::make_move_iterator( first + written_last ) );
+      }
+      else
+      {
+        // the last block was written to the overflow buffer
+        const long split = ( bucket_last < written_last ) ? bucket_last : written_last;
+        move_block( overflow.begin(), split - last_slot * b, first + last_slot * b );
+        saved[i].assign( std::make_move_iterator( overflow.begin() + (split - last_slot * b) ),
+                         std::make_move_iterator( overflow.end() ) );
+      }
+    }
+  }
+
+  // 4b. writes the saved elements and the buffers of a bucket into the gaps
+  //     at the beginning and end of the bucket
+  void write_buffers()
+  {
+    int i;
+    while( (i = std::atomic_fetch_add( &next_bucket, 1 )) < k )
+    {
+      const long bucket_last = bucket_begin[i+1];
+      const long head_last = ( region_begin[i] * b < bucket_last )
+                             ? region_begin[i] * b : bucket_last;
+      const long tail_first = ( region_begin[i] + bucket_blocks[i] ) * b;
+      long pos = bucket_begin[i];
+      auto put = [&]( T &elem )
+      {
+        if( pos == head_last && pos < tail_first ) pos = tail_first;
+        *(first + pos) = std::move( elem );
+        ++pos;
+      };
+      for( auto &elem : saved[i] ) put( elem );
+      for( int tid = 0; tid < num; ++tid )
+      {
+        T *bucket_buffer = buffers[tid].data() + i * b;
+        for( long e = 0; e < fill[tid][i]; ++e ) put( bucket_buffer[e] );
+      }
+    }
+  }
+};
+
+// partitions an array into k buckets
+// must be called inside a parallel region, the phases run as num tasks
+// first, last = array borders
+// classify = returns the bucket (0 ... k-1) of an element
+// b = elements per block, num = number of tasks
+// bucket_begin = receives the first element-index of every bucket and n (k+1)
+template< class FwdIt, class Classifier >
+inline void multiway_partition( const FwdIt first, const FwdIt last,
+                                const Classifier &classify, const int k,
+                                const long b, const int num, long *bucket_begin )
+{
+  multiway_state< FwdIt, Classifier > state( first, last - first, classify, k, b, num );
+
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task firstprivate( tid ) shared( state ) if( num > 1 )
+    state.classify_locally( tid );
+  }
+#pragma omp taskwait
+  state.compute_borders();
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task shared( state ) if( num > 1 )
+    state.move_empty_blocks();
+  }
+#pragma omp taskwait
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task firstprivate( tid ) shared( state ) if( num > 1 )
+    state.permute_blocks( tid );
+  }
+#pragma omp taskwait
+  state.next_bucket = 0;
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task shared( state ) if( num > 1 )
+    state.save_overflow();
+  }
+#pragma omp taskwait
+  state.next_bucket = 0;
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task shared( state ) if( num > 1 )
+    state.write_buffers();
+  }
+#pragma omp taskwait
+  std::copy( state.bucket_begin.begin(), state.bucket_begin.end(), bucket_begin );
+}
+
+// launches a parallel region if not has been started already
+// invokes the multiway partitioning
+template< class FwdIt, class Classifier >
+inline void multiway_partition_run( const bool omp_parallel_active,
+                                    const FwdIt first, const FwdIt last,
+                                    const Classifier &classify, const int k,
+                                    const long b, const int num, long *bucket_begin )
+{
+  if( omp_parallel_active || num == 1 )
+  {
+    multiway_partition( first, last, classify, k, b, num, bucket_begin );
+  }
+  else
+  {
+    team_run( num, [&]()
+    {
+#pragma omp single
+      multiway_partition( first, last, classify, k, b, num, bucket_begin );
+    } );
+  }
+}
+
+// ppartition3: three-way partitioning in one pass over the array
+// the threads claim blocks like parallel_phase and neutralize them by
+// lower() (class 0), every finished right-side block holds class 1 and 2
+// only and is split by upper() (class 0 or 1) at once, while it is still in
+// the cache, see block_partitioning3
+// afterwards only the few unfinished blocks and the misplaced class 1 and 2
+// elements are touched again, the two-way partitionings one after the other
+// (partition3_passes) read the right side twice and are left to the
+// unfinished blocks and the NUMA mode
+// (multiway_partition with three buckets reads and writes every element
+// twice and was slower than both)
+// a three-way classifier provides the two-way predicates lower() (class 0)
+// and upper() (class 0 or 1)
+
+// T may be a const reference: the sorts keep their pivots in the array, see
+// pivot_type
+// one pivot: 0 = elem < pivot, 1 = elem == pivot, 2 = elem > pivot
+template< class T, class Compare >
+struct pivot_classifier
+{
+  using value_type = typename std::decay<T>::type;
+  T pivot;
+  Compare cmp;
+  less_than_pivot< value_type, Compare > lower() const { return { pivot, cmp }; }
+  not_greater_than_pivot< value_type, Compare > upper() const { return { pivot, cmp }; }
+};
+
+// two pivots, pivot1 <= pivot2:
+// 0 = elem < pivot1, 1 = pivot1 <= elem <= pivot2, 2 = elem > pivot2
+template< class T, class Compare >
+struct dual_pivot_classifier
+{
+  using value_type = typename std::decay<T>::type;
+  T pivot1;
+  T pivot2;
+  Compare cmp;
+  less_than_pivot< value_type, Compare > lower() const { return { pivot1, cmp }; }
+  not_greater_than_pivot< value_type, Compare > upper() const { return { pivot2, cmp }; }
+};
+
+// partitions an array into three groups single-threaded
+// returns the first element of the middle and of the right-side group
+template< class Kernel = scanning_kernel, class FwdIt, class Classifier >
+constexpr std::pair< FwdIt, FwdIt > spartition3( const FwdIt first, const FwdIt last,
+                                                 const Classifier &classify )
+{
+  const FwdIt middle1 = spartition< Kernel >( first, last, classify.lower() );
+  const FwdIt middle2 = spartition< Kernel >( middle1, last, classify.upper() );
+  return { middle1, middle2 };
+}
+
+// swaps the adjacent groups [first, middle) and [middle, last) of one class
+// each with min( middle - first, last - middle ) swaps, the order inside a
+// group does not matter
+// returns the new border between them
+template< class FwdIt >
+inline FwdIt swap_groups( const FwdIt first, const FwdIt middle, const FwdIt last )
+{
+  const auto left = std::distance( first, middle );
+  const auto right = std::distance( middle, last );
+  if( left < right )
+    std::swap_ranges( first, middle, last - left );
+  else
+    std::swap_ranges( first, first + right, middle );
+  return first + right;
+}
+
+// both two-way partitionings one after the other, called inside a parallel
+// region
+template< long BlockSize, class Kernel, class FwdIt, class Classifier >
+inline std::pair< FwdIt, FwdIt > partition3_passes( const FwdIt first, const FwdIt last,
+                                                    const Classifier &classify,
+                                                    const int num )
+{
+  const long B = block_size< BlockSize,
+                             typename std::iterator_traits<FwdIt>::value_type >();
   // ppartitioning is more efficient for arrays not fitting in cache
   // spartitioning has less overhead once the array fitts in cache
-  if( std::distance(first,last) >= 2*B )
+  const FwdIt middle1 = ( std::distance( first, last ) >= 2*B )
+    ? ppartition< BlockSize, Kernel >( first, last, classify.lower(), num, true )
+    : spartition< Kernel >( first, last, classify.lower() );
+  const FwdIt middle2 = ( std::distance( middle1, last ) >= 2*B )
+    ? ppartition< BlockSize, Kernel >( middle1, last, classify.upper(), num, true )
+    : spartition< Kernel >( middle1, last, classify.upper() );
+  return { middle1, middle2 };
+}
+
+// blockwise three-way partitioning in one pass
+// work and exchange can be called concurrently by different slots
+// the bookkeeping is taken from frame, so the partitioning lives in the
+// scope of the frame on the thread which creates it
+template< long BlockSize, class Kernel, class FwdIt, class Classifier >
+class block_partitioning3
+{
+public:
+  block_partitioning3( ppq::scratch_frame &frame, const FwdIt first, const FwdIt last,
+                       const Classifier &classify, const int slots, const long B )
+    : first( first ), last( last ), classify( classify ), slots( slots ), B( B ),
+      full_blocks( std::distance( first, last ) / B ),
+      ones( frame.take<long>( full_blocks ) ),
+      remainingBlocks( frame.take<long>( slots ) ),
+      wrong_two( frame, full_blocks + 1 ), wrong_one( frame, full_blocks + 1 ),
+      numRemainingBlocks( full_blocks )
+  {
+    std::fill( remainingBlocks, remainingBlocks + slots, full_blocks * B );
+  }
+
+  // 1. neutralizes the complete blocks by lower(), a finished right-side
+  // block is split by upper() and its class 1 elements are counted
+  void work( const int slot )
+  {
+    auto split = [this]( const FwdIt block_first, const FwdIt block_last )
+    {
+      const FwdIt middle = spartition< Kernel >( block_first, block_last, classify.upper() );
+      ones[ std::distance( first, block_first ) / B ] = std::distance( block_first, middle );
+    };
+    neutralize_claimed_blocks< Kernel >( first, first + full_blocks * B, classify.lower(),
+                                         numRemainingBlocks, i, j, B,
+                                         remainingBlocks[slot], split );
+  }
+
+  // 2. swaps the unfinished blocks next to the border of the sides and
+  // partitions them by partition3_passes, then every complete block behind
+  // the class 0 group is ( class 1, class 2 ): plans the exchange of the
+  // class 2 elements in front of the final border with the class 1
+  // elements behind it, called by the thread which created the partitioning
+  void prepare_exchange( const int num )
+  {
+    const long left_blocks = i.load();
+    ppq::scratch_frame frame;
+    ppq::scratch_vector<long> unfinished( frame, slots );
+    for( int slot = 0; slot < slots; ++slot )
+      if( remainingBlocks[slot] != full_blocks * B )
+        unfinished.push_back( remainingBlocks[slot] / B );
+    std::sort( unfinished.begin(), unfinished.end() );
+    ppq::stats_partition( slots, unfinished.size() );
+    const long *right_unfinished =
+      std::lower_bound( unfinished.begin(), unfinished.end(), left_blocks );
+    const long middle_first = left_blocks - ( right_unfinished - unfinished.begin() );
+    const long middle_last = left_blocks + ( unfinished.end() - right_unfinished );
+
+    // unfinished blocks outside of [middle_first, middle_last) change places
+    // with finished blocks of the same side inside, which keep their counts
+    auto is_unfinished = [&unfinished]( const long block )
+    {
+      return std::binary_search( unfinished.begin(), unfinished.end(), block );
+    };
+    ppq::scratch_vector< std::pair<long, long> > swaps( frame, unfinished.size() );
+    const long *outside = unfinished.begin();
+    for( long block = middle_first; block < left_blocks; ++block )
+      if( !is_unfinished( block ) ) swaps.push_back( { *outside++, block } );
+    outside = std::lower_bound( unfinished.begin(), unfinished.end(), middle_last );
+    for( long block = left_blocks; block < middle_last; ++block )
+      if( !is_unfinished( block ) )
+      {
+        ones[*outside] = ones[block];
+        swaps.push_back( { *outside++, block } );
+      }
+    for( std::size_t k = 0; k < swaps.size(); ++k )
+    {
+#pragma omp task firstprivate( k ) shared( swaps ) if( num > 1 && swaps.size() > 1 )
+      swapBlocks( first + swaps[k].first * B, first + (swaps[k].first + 1) * B,
+                  first + swaps[k].second * B, first + (swaps[k].second + 1) * B );
+    }
+#pragma omp taskwait
+    const auto middles = partition3_passes< BlockSize, Kernel >( first + middle_first * B,
+                                                                 first + middle_last * B,
+                                                                 classify, num );
+
+    // the final border of the complete blocks lies behind all class 1
+    // elements
+    long one_count = std::distance( middles.first, middles.second );
+    for( long block = middle_last; block < full_blocks; ++block ) one_count += ones[block];
+    border1 = std::distance( first, middles.first );
+    border2 = border1 + one_count;
+    // segment [begin, end) = ( count class 1 elements, class 2 elements )
+    auto plan = [this]( const long begin, const long end, const long count )
+    {
+      const long split = begin + count;
+      if( split < std::min( end, border2 ) )
+        add_run( wrong_two, split, std::min( end, border2 ) );
+      if( std::max( begin, border2 ) < split )
+        add_run( wrong_one, std::max( begin, border2 ), split );
+    };
+    plan( border1, middle_last * B, std::distance( middles.first, middles.second ) );
+    for( long block = middle_last; block < full_blocks; ++block )
+      plan( block * B, (block + 1) * B, ones[block] );
+    misplaced = wrong_two.empty() ? 0 : wrong_two.back().in_front + length_of( wrong_two.back() );
+  }
+
+  // 3. swaps the claimed pieces, piece k = the elements [k B, (k + 1) B) of
+  // the misplaced class 2 elements with the same elements of the misplaced
+  // class 1 elements
+  void exchange()
+  {
+    for( long k = next_piece++; k * B < misplaced; k = next_piece++ )
+    {
+      long offset = k * B;
+      const long end = std::min( misplaced, offset + B );
+      std::size_t two = find_run( wrong_two, offset );
+      std::size_t one = find_run( wrong_one, offset );
+      while( offset < end )
+      {
+        const long left = wrong_two[two].begin + ( offset - wrong_two[two].in_front );
+        const long right = wrong_one[one].begin + ( offset - wrong_one[one].in_front );
+        const long length = std::min( { end - offset, wrong_two[two].end - left,
+                                        wrong_one[one].end - right } );
+        std::swap_ranges( first + left, first + (left + length), first + right );
+        offset += length;
+        if( left + length == wrong_two[two].end ) ++two;
+        if( right + length == wrong_one[one].end ) ++one;
+      }
+    }
+  }
+
+  // 4. partitions the incomplete last block and swaps its class 0 and
+  // class 1 groups in front of the class 2 group of the complete blocks
+  // returns the first element of the middle and of the right-side group
+  std::pair< FwdIt, FwdIt > complete() const
+  {
+    const FwdIt tail = first + full_blocks * B;
+    if( tail == last ) return { first + border1, first + border2 };
+    const auto groups = spartition3< Kernel >( tail, last, classify );
+    const FwdIt twos = swap_groups( first + border2, tail, groups.first );
+    const FwdIt middle1 = swap_groups( first + border1, first + border2, twos );
+    const FwdIt middle2 = swap_groups( twos, groups.first, groups.second );
+    return { middle1, middle2 };
+  }
+
+  // misplaced elements [begin, end), in_front = misplaced elements of the
+  // same class in front of them
+  struct run
+  {
+    long begin, end, in_front;
+  };
+
+private:
+  static long length_of( const run &r ) { return r.end - r.begin; }
+
+  static void add_run( ppq::scratch_vector<run> &runs, const long begin, const long end )
+  {
+    const long in_front = runs.empty() ? 0 : runs.back().in_front + length_of( runs.back() );
+    runs.push_back( { begin, end, in_front } );
+  }
+
+  // run containing the misplaced element offset
+  static std::size_t find_run( const ppq::scratch_vector<run> &runs, const long offset )
+  {
+    const run *it = std::upper_bound( runs.begin(), runs.end(), offset,
+                                      []( const long value, const run &r )
+                                      { return value < r.in_front; } );
+    return ( it - runs.begin() ) - 1;
+  }
+
+  const FwdIt first;
+  const FwdIt last;
+  const Classifier classify;
+  const int slots;
+  const long B;
+  const long full_blocks;
+  // class 1 elements of the finished right-side blocks
+  long *ones;
+  long *remainingBlocks;
+  ppq::scratch_vector<run> wrong_two, wrong_one;
+  std::atomic<int> numRemainingBlocks;
+  std::atomic<int> i{ 0 };
+  std::atomic<int> j{ 1 };
+  long border1 = 0;
+  long border2 = 0;
+  long misplaced = 0;
+  std::atomic<long> next_piece{ 0 };
+};
+
+namespace ppq
+{
+inline std::size_t partition3_scratch_bytes( const long n, const long B, const int num )
+{
+  // counts, run lists, remaining and unfinished blocks, the swaps and the
+  // alignment
+  using run = block_partitioning3< 0, scanning_kernel, long*,
+                                   pivot_classifier< long, std::less<> > >::run;
+  const std::size_t blocks = n / B + 1;
+  return blocks * sizeof( long ) + 2 * blocks * sizeof( run ) + 2 * num * sizeof( long ) +
+         num * sizeof( std::pair<long, long> ) + 6 * alignof( std::max_align_t );
+}
+} // namespace ppq
+
+// ppartition3 called inside a parallel region
+template< long BlockSize, class Kernel, class FwdIt, class Classifier >
+inline std::pair< FwdIt, FwdIt > partition3_phases( const FwdIt first, const FwdIt last,
+                                                    const Classifier &classify,
+                                                    const int num )
+{
+  const long B = block_size< BlockSize,
+                             typename std::iterator_traits<FwdIt>::value_type >();
+  const long N = std::distance( first, last );
+  // spartitioning has less overhead once the array fitts in cache, the NUMA
+  // mode keeps its segments for both passes
+  if( N < 2*B )
+    return spartition3< Kernel >( first, last, classify );
+  if( numa_mode( N, num ) )
+    return partition3_passes< BlockSize, Kernel >( first, last, classify, num );
+  ppq::scratch_frame frame;
+  block_partitioning3< BlockSize, Kernel, FwdIt, Classifier > partitioning( frame, first, last,
+                                                                            classify, num, B );
+  ppq::stats_timer timer( ppq::parallel_phase_time );
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task firstprivate( tid ) shared( partitioning ) if( num > 1 )
+    partitioning.work( tid );
+  }
+#pragma omp taskwait
+  timer.next( ppq::neutralization_time );
+  partitioning.prepare_exchange( num );
+  timer.next( ppq::swapping_time );
+  for( int tid = 0; tid < num; ++tid )
+  {
+#pragma omp task shared( partitioning ) if( num > 1 )
+    partitioning.exchange();
+  }
+#pragma omp taskwait
+  if( num > 1 ) ppq::stats_add( &ppq::stats::tasks, 2 * num );
+  timer.next( ppq::final_partition_time );
+  return partitioning.complete();
+}
+
+// parallel three-way partitioner
+// BlockSize = elements per block, 0 selects the block size policy default
+// Kernel = neutralization kernel
+// returns the first element of the middle and of the right-side group
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Classifier >
+std::pair< FwdIt, FwdIt > ppartition3( const FwdIt first, const FwdIt last,
+                                       const Classifier &classify,
+                                       const int num = omp_get_max_threads(),
+                                       const bool omp_parallel_active = false )
+{
+  if( omp_parallel_active || num == 1 )
+    return partition3_phases< BlockSize, Kernel >( first, last, classify, num );
+  const long B = block_size< BlockSize,
+                             typename std::iterator_traits<FwdIt>::value_type >();
+  std::pair< FwdIt, FwdIt > middles;
+  team_run( num, [&]()
+  {
+    ppq::reserve_scratch( ppq::partition_scratch_bytes( num ) +
+                          ppq::partition3_scratch_bytes( std::distance( first, last ), B, num ) );
+#pragma omp single
+    middles = partition3_phases< BlockSize, Kernel >( first, last, classify, num );
+  } );
+  return middles;
+}
+
+// pivot sampling
+// small arrays: median of three (first, middle, last element)
+// medium arrays: Tukey's ninther, the median of three medians of three
+// large arrays: median of about sqrt(n) samples, one from every stride at a
+//               pseudo-random offset, so equally spaced patterns do not hit
+//               the samples
+
+// arrays from this size on use the ninther
+constexpr long ninther_threshold = 128;
+// arrays from this size on use sqrt(n) samples
+constexpr long sample_pivot_threshold = 1L << 16;
+
+// draws about sqrt(n) samples, one per stride
+// the samples are iterators, so no element is copied, their space is taken
+// from the scratch arena
+template< class FwdIt >
+inline ppq::scratch_vector< FwdIt > pivot_samples( ppq::scratch_frame &frame,
+                                                    const FwdIt first, const long distance )
+{
+  const long count = static_cast<long>( std::sqrt( static_cast<double>( distance ) ) ) | 1;
+  const long stride = distance / count;
+  ppq::scratch_vector< FwdIt > samples( frame, count );
+  unsigned long long state = 0x9E3779B97F4A7C15ull ^ static_cast<unsigned long long>( distance );
+  for( long k = 0; k < count; ++k )
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    samples.push_back( first + ( k * stride + static_cast<long>( state % stride ) ) );
+  }
+  return samples;
+}
+
+// median of three elements given by iterators
+template< class FwdIt, class Compare >
+inline FwdIt median_of_three( const FwdIt a, const FwdIt b, const FwdIt c,
+                              const Compare cmp )
+{
+  if( cmp( *a, *b ) )
+  {
+    if( cmp( *b, *c ) ) return b;
+    return cmp( *a, *c ) ? c : a;
+  }
+  if( cmp( *a, *c ) ) return a;
+  return cmp( *b, *c ) ? c : b;
+}
+
+// returns the position of the pivot of quicksort and pquickselect
+template< class FwdIt, class Compare >
+inline FwdIt choose_pivot( const FwdIt first, const FwdIt last, const Compare cmp )
+{
+  const long distance = std::distance( first, last );
+  if( distance < ninther_threshold )
+    return median_of_three( first, first + distance/2, last - 1, cmp );
+  if( distance < sample_pivot_threshold )
+  {
+    const long s = distance / 8;
+    const long m = distance / 2;
+    return median_of_three( median_of_three( first, first + s, first + 2*s, cmp ),
+                            median_of_three( first + (m - s), first + m, first + (m + s), cmp ),
+                            median_of_three( last - (2*s + 1), last - (s + 1), last - 1, cmp ),
+                            cmp );
+  }
+  ppq::scratch_frame frame;
+  auto samples = pivot_samples( frame, first, distance );
+  const auto median = samples.begin() + samples.size()/2;
+  std::nth_element( samples.begin(), median, samples.end(),
+                    [&cmp]( const FwdIt a, const FwdIt b ) { return cmp( *a, *b ); } );
+  return *median;
+}
+
+// returns the positions of the pivots of the dual pivot quicksort,
+// *pivot1 <= *pivot2, both may be the same element
+// medium and large arrays use the tertiles of the samples
+template< class FwdIt, class Compare >
+inline std::pair< FwdIt, FwdIt >
+choose_pivots( const FwdIt first, const FwdIt last, const Compare cmp )
+{
+  const long distance = std::distance( first, last );
+  if( distance < ninther_threshold )
+  {
+    const FwdIt pivot1 = median_of_three( first, first + distance/2, last - 1, cmp );
+    const FwdIt pivot2 = median_of_three( first + distance/2, first + 3*distance/4,
+                                          last - 1, cmp );
+    if( cmp( *pivot2, *pivot1 ) ) return { pivot2, pivot1 };
+    return { pivot1, pivot2 };
+  }
+  ppq::scratch_frame frame;
+  auto samples = pivot_samples( frame, first, distance );
+  insertion_sort( samples.begin(), samples.end(),
+                  [&cmp]( const FwdIt a, const FwdIt b ) { return cmp( *a, *b ); } );
+  return { samples[samples.size()/3], samples[2*samples.size()/3] };
+}
+
+// the sorts keep their pivots in the array instead of copying them: the
+// pivots are swapped to the ends of the range, the partitioning skips the
+// ends and the classifiers refer to them, afterwards the pivots are swapped
+// into the middle group
+// proxy iterators ( zip_iterator ) yield no references, their pivots are
+// copied
+template< class FwdIt >
+using pivot_type = typename std::conditional<
+  std::is_reference< typename std::iterator_traits<FwdIt>::reference >::value,
+  const typename std::iterator_traits<FwdIt>::value_type &,
+  typename std::iterator_traits<FwdIt>::value_type >::type;
+
+// swaps the pivot to the first element
+template< class FwdIt, class Compare >
+inline void pivot_to_front( const FwdIt first, const FwdIt last, const Compare cmp )
+{
+  const FwdIt pivot = choose_pivot( first, last, cmp );
+  if( pivot != first ) std::iter_swap( first, pivot );
+}
+
+// swaps the pivots of the dual pivot quicksort to the first and the last
+// element, returns false and swaps nothing if the pivots are equal, e.g.
+// both are the same element of a small array
+template< class FwdIt, class Compare >
+inline bool pivots_to_ends( const FwdIt first, const FwdIt last, const Compare cmp )
+{
+  const auto pivots = choose_pivots( first, last, cmp );
+  if( pivots.first == pivots.second || !cmp( *pivots.first, *pivots.second ) ) return false;
+  FwdIt pivot2 = pivots.second;
+  if( pivots.first != first )
+  {
+    std::iter_swap( first, pivots.first );
+    if( pivot2 == first ) pivot2 = pivots.first;
+  }
+  if( pivot2 != last - 1 ) std::iter_swap( last - 1, pivot2 );
+  return true;
+}
+
+// the pivot at first joins the middle group [middle1, ...) of the
+// partitioning of [first + 1, ...)
+template< class FwdIt >
+inline void place_pivot( const FwdIt first, FwdIt &middle1 )
+{
+  --middle1;
+  if( middle1 != first ) std::iter_swap( first, middle1 );
+}
+
+// the pivots at first and last - 1 join the middle group [middle1, middle2)
+// of the partitioning of [first + 1, last - 1)
+template< class FwdIt >
+inline void place_pivots( const FwdIt first, const FwdIt last,
+                          FwdIt &middle1, FwdIt &middle2 )
+{
+  place_pivot( first, middle1 );
+  if( middle2 != last - 1 ) std::iter_swap( last - 1, middle2 );
+  ++middle2;
+}
+
+// introsort: quicksort falls back to merge_sort after 2*log2(n) levels, so
+// adversarial inputs cost O(n log n) and the recursion depth is bounded
+inline int introsort_depth( long distance )
+{
+  int depth = 0;
+  for( ; distance > 1; distance >>= 1 ) depth += 2;
+  return depth;
+}
+
+// fallback of quicksort and pquickselect
+// parallel merge sort, the part of every task is heap sorted
+// num = number of threads, tasks are only started inside a parallel region
+template< class FwdIt, class Compare >
+void merge_sort( const FwdIt first, const FwdIt last, const Compare cmp,
+                 const int num = 1 )
+{
+  const long distance = std::distance( first, last );
+  if( num <= 1 || distance <= 10000 )
+  {
+    std::make_heap( first, last, cmp );
+    std::sort_heap( first, last, cmp );
+    return;
+  }
+  const FwdIt middle = std::next( first, distance/2 );
+#pragma omp task
+  merge_sort( first, middle, cmp, num/2 );
+#pragma omp task
+  merge_sort( middle, last, cmp, num - num/2 );
+#pragma omp taskwait
+  std::inplace_merge( first, middle, last, cmp );
+}
+
+// swaps some elements after a bad partitioning (pdqsort), so patterns of
+// the input, e.g. median-of-three killer sequences, do not repeat in the
+// pivot samples of the next level
+template< class FwdIt >
+inline void break_patterns( const FwdIt first, const FwdIt last )
+{
+  const long distance = std::distance( first, last );
+  if( distance <= 32 ) return;
+  const long quarter = distance / 4;
+  std::iter_swap( first, first + quarter );
+  std::iter_swap( last - 1, last - quarter );
+  if( distance >= ninther_threshold )
+  {
+    std::iter_swap( first + 1, first + (quarter + 1) );
+    std::iter_swap( first + 2, first + (quarter + 2) );
+    std::iter_swap( last - 2, last - (quarter + 1) );
+    std::iter_swap( last - 3, last - (quarter + 2) );
+  }
+}
+
+// a partitioning is bad if one side keeps more than 7/8 of the elements
+constexpr bool bad_partitioning( const long side, const long distance )
+{
+  return side > distance - distance/8;
+}
+
+// presorted input
+// the starters of pquicksort, pquicksort_dual_pivot and psamplesort look for
+// natural runs first: every task scans a chunk for descents
+// (elem[i] < elem[i-1]) and ascents, all tasks give up as soon as there are
+// too many descents and at least one ascent, so random input costs a few
+// comparisons per thread
+// - no descent: the array is sorted
+// - no ascent: the array is reverse sorted and gets reversed
+// - at most max_presorted_runs runs: the runs are merged by a parallel
+//   k-way merge
+// the functions are called by one thread inside a parallel region and
+// start one task per chunk
+
+// arrays smaller than this are not checked
+constexpr long presorted_threshold = 1L << 12;
+// maximum number of natural runs merged instead of sorted
+constexpr long max_presorted_runs = 64;
+
+// result of find_runs
+enum presorted_kind { presorted_none, presorted_sorted, presorted_reverse, presorted_runs };
+
+// runs chunk( t ) for t = 0 .. num-1 as tasks and waits for them
+template< class Chunk >
+inline void chunk_tasks( const int num, const Chunk &chunk )
+{
+  for( int t = 0; t < num; ++t )
+  {
+#pragma omp task firstprivate( t ) shared( chunk ) if( num > 1 )
+    chunk( t );
+  }
+#pragma omp taskwait
+}
+
+// scans the array for natural runs
+// starts = receives the first element-index of every run except the first
+template< class FwdIt, class Compare >
+inline presorted_kind find_runs( const FwdIt first, const FwdIt last,
+                                 const Compare cmp, const int num,
+                                 std::vector<long> &starts )
+{
+  const long n = std::distance( first, last );
+  std::atomic<long> descents( 0 );
+  std::atomic<bool> ascent( false );
+  std::atomic<bool> give_up( false );
+  std::vector< std::vector<long> > local( num );
+
+  chunk_tasks( num, [&]( const int t )
+  {
+    const long begin = ( n * t / num > 0 ) ? n * t / num : 1;
+    const long end = n * (t + 1) / num;
+    auto &mine = local[t];
+    bool seen_ascent = false;
+    for( long i = begin; i < end && !give_up.load( std::memory_order_relaxed ); ++i )
+    {
+      if( cmp( *(first + i), *(first + (i - 1)) ) )
+      {
+        // positions beyond the limit are not needed any more
+        if( std::atomic_fetch_add( &descents, 1L ) < max_presorted_runs )
+          mine.push_back( i );
+        else if( ascent.load( std::memory_order_relaxed ) )
+          give_up = true;
+      }
+      else if( !seen_ascent && cmp( *(first + (i - 1)), *(first + i) ) )
+      {
+        seen_ascent = true;
+        ascent = true;
+        if( descents.load( std::memory_order_relaxed ) >= max_presorted_runs )
+          give_up = true;
+      }
+    }
+  } );
+  if( give_up ) return presorted_none;
+  if( descents == 0 ) return presorted_sorted;
+  if( !ascent ) return presorted_reverse;
+  if( descents >= max_presorted_runs ) return presorted_none;
+  for( const auto &positions : local )
+    starts.insert( starts.end(), positions.begin(), positions.end() );
+  return presorted_runs;
+}
+
+// parallel is_sorted, the threads stop at the first descent of any thread
+template< class FwdIt, class Compare = std::less<> >
+bool pis_sorted( const FwdIt first, const FwdIt last,
+                 const Compare cmp = Compare{},
+                 const int num = omp_get_max_threads() )
+{
+  const long n = std::distance( first, last );
+  if( n < presorted_threshold ) return std::is_sorted( first, last, cmp );
+  std::atomic<bool> sorted( true );
+  team_run( num, [&]()
+  {
+    const int tid = omp_get_thread_num();
+    const int threads = omp_get_num_threads();
+    const long begin = ( n * tid / threads > 0 ) ? n * tid / threads : 1;
+    const long end = n * (tid + 1) / threads;
+    for( long i = begin; i < end && sorted.load( std::memory_order_relaxed ); ++i )
+      if( cmp( *(first + i), *(first + (i - 1)) ) ) sorted = false;
+  } );
+  return sorted;
+}
+
+// merges the sorted runs [starts[j], starts[j+1]) in parallel
+// every task merges the elements between two splitters out of all runs
+// with a heap of the run heads into a buffer, the splitters are drawn from
+// an equally spaced sample
+// starts = first element-index of every run and n at the end
+template< class FwdIt, class Compare >
+inline void pmerge_runs( const FwdIt first, const FwdIt last, const Compare cmp,
+                         const std::vector<long> &starts, const int num )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  const long n = std::distance( first, last );
+  const int k = starts.size() - 1;
+
+  // splitters of the tasks
+  std::vector<T> sample;
+  const long sample_size = 16 * static_cast<long>( num );
+  sample.reserve( sample_size );
+  for( long s = 0; s < sample_size; ++s )
+    sample.push_back( *(first + ( n * s / sample_size )) );
+  std::sort( sample.begin(), sample.end(), cmp );
+  // bounds[t*(k+1) + j] = first element of task t in run j
+  // bounds[t*(k+1) + k] = first output position of task t
+  std::vector<long> bounds( (num + 1) * (k + 1) );
+  for( int t = 0; t <= num; ++t )
+  {
+    long out = 0;
+    for( int j = 0; j < k; ++j )
+    {
+      long bound = ( t == num ) ? starts[j+1] : starts[j];
+      if( t > 0 && t < num )
+        bound = std::lower_bound( first + starts[j], first + starts[j+1],
+                                  sample[t * sample_size / num], cmp ) - first;
+      bounds[t * (k + 1) + j] = bound;
+      out += bound - starts[j];
+    }
+    bounds[t * (k + 1) + k] = out;
+  }
+
+  // the buffer is uninitialized, elements are constructed by the merge
+  // the scratch space of the context is reused if its team runs the call,
+  // other teams allocate
+  ppq::context *ctx = ppq::context::team();
+  std::allocator<T> allocator;
+  T *buffer = ( ctx != nullptr )
+    ? static_cast<T*>( ctx->scratch( n * sizeof(T) ) )
+    : allocator.allocate( n );
+
+  chunk_tasks( num, [&]( const int t )
+  {
+    const long *lower = bounds.data() + t * (k + 1);
+    const long *upper = bounds.data() + (t + 1) * (k + 1);
+    long out = lower[k];
+    // min-heap of the runs with elements left, ordered by their heads
+    std::vector<long> head( lower, lower + k );
+    std::vector<int> heap;
+    for( int j = 0; j < k; ++j )
+      if( head[j] < upper[j] ) heap.push_back( j );
+    auto greater_head = [&]( const int a, const int b )
+    {
+      return cmp( *(first + head[b]), *(first + head[a]) );
+    };
+    std::make_heap( heap.begin(), heap.end(), greater_head );
+    while( !heap.empty() )
+    {
+      const int j = heap.front();
+      ::new( static_cast<void*>( buffer + out ) ) T( std::move( *(first + head[j]) ) );
+      ++out;
+      if( ++head[j] == upper[j] )
+      {
+        heap.front() = heap.back();
+        heap.pop_back();
+      }
+      // sift the new head down
+      const long size = heap.size();
+      for( long pos = 0; 2 * pos + 1 < size; )
+      {
+        long child = 2 * pos + 1;
+        if( child + 1 < size && greater_head( heap[child], heap[child+1] ) ) ++child;
+        if( !greater_head( heap[pos], heap[child] ) ) break;
+        std::swap( heap[pos], heap[child] );
+        pos = child;
+      }
+    }
+  } );
+  chunk_tasks( num, [&]( const int t )
+  {
+    for( long i = bounds[t * (k + 1) + k]; i < bounds[(t + 1) * (k + 1) + k]; ++i )
+    {
+      *(first + i) = std::move( buffer[i] );
+      buffer[i].~T();
+    }
+  } );
+  if( ctx == nullptr ) allocator.deallocate( buffer, n );
+}
+
+// sorts sorted, reverse sorted and few-run arrays without partitioning
+// returns false if the array has too many runs and has to be sorted
+template< class FwdIt, class Compare >
+inline bool presorted_sort( const FwdIt first, const FwdIt last,
+                            const Compare cmp, const int num )
+{
+  const long n = std::distance( first, last );
+  if( n < presorted_threshold ) return false;
+  std::vector<long> starts( 1, 0 );
+  switch( find_runs( first, last, cmp, num, starts ) )
+  {
+    case presorted_sorted:
+      return true;
+    case presorted_reverse:
+      chunk_tasks( num, [&]( const int t )
+      {
+        for( long i = n / 2 * t / num; i < n / 2 * (t + 1) / num; ++i )
+          std::iter_swap( first + i, first + (n - 1 - i) );
+      } );
+      return true;
+    case presorted_runs:
+      starts.push_back( n );
+      pmerge_runs( first, last, cmp, starts, num );
+      return true;
+    default:
+      return false;
+  }
+}
+
+// standard quicksort, single threaded
+// pquicksort sorts in parallel with the work-stealing scheduler below
+// depth = remaining levels until the merge_sort fallback, only for intern
+//         use, -1 selects 2*log2(n)
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void quicksort( const FwdIt first, const FwdIt last,
+                const Compare cmp = Compare{}, int depth = -1 )
+{
+  const long distance = std::distance( first, last );
+  // insertionsort is faster for small arrays
+  if( distance <= 32 )
+  {
+    insertion_sort( first, last, cmp );
+    return;
+  }
+  if( depth < 0 )
+  {
+    depth = introsort_depth( distance );
+    ppq::stats_depth_limit( depth );
+    ppq::reserve_scratch( ppq::sort_scratch_bytes<FwdIt>( distance, 1 ) );
+  }
+  ppq::stats_depth( depth );
+  if( depth == 0 )
+  {
+    merge_sort( first, last, cmp );
+    return;
+  }
+  // larger pivot samples are more robust for natrual distributions
+  // three-way partitioning, the elements equal to the pivot are excluded
+  // from the recursion to avoid getting stuck
+  pivot_to_front( first, last, cmp );
+  const pivot_classifier< pivot_type<FwdIt>, Compare > classify{ *first, cmp };
+  FwdIt middle1, middle2;
+  std::tie( middle1, middle2 ) =
+    ppartition3< BlockSize, Kernel >( first + 1, last, classify, 1, true );
+  place_pivot( first, middle1 );
+
+  const long distance1 = std::distance( first, middle1 );
+  const long distance2 = std::distance( middle2, last );
+  if( bad_partitioning( distance1, distance ) || bad_partitioning( distance2, distance ) )
+  {
+    ppq::stats_add( &ppq::stats::bad_partitions, 1 );
+    break_patterns( first, middle1 );
+    break_patterns( middle2, last );
+  }
+  quicksort< BlockSize, Kernel >( first, middle1, cmp, depth - 1 );
+  quicksort< BlockSize, Kernel >( middle2, last, cmp, depth - 1 );
+}
+
+// dual pivot quicksort, single threaded
+// pquicksort_dual_pivot sorts in parallel with the work-stealing scheduler
+// depth = remaining levels until the merge_sort fallback, only for intern
+//         use, -1 selects 2*log2(n)
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void quicksort_dual_pivot( const FwdIt first, const FwdIt last,
+                           const Compare cmp = Compare{}, int depth = -1 )
+{
+  const long distance = std::distance( first, last );
+  // insertionsort is faster for small arrays
+  if( distance <= 32 )
+  {
+    insertion_sort( first, last, cmp );
+    return;
+  }
+  if( depth < 0 )
+  {
+    depth = introsort_depth( distance );
+    ppq::stats_depth_limit( depth );
+    ppq::reserve_scratch( ppq::sort_scratch_bytes<FwdIt>( distance, 1 ) );
+  }
+  ppq::stats_depth( depth );
+  if( depth == 0 )
+  {
+    merge_sort( first, last, cmp );
+    return;
+  }
+  // tertiles of the pivot samples
+  // equal pivots: the standard quicksort excludes the equal elements
+  if( !pivots_to_ends( first, last, cmp ) )
+  {
+    quicksort< BlockSize, Kernel >( first, last, cmp, depth );
+    return;
+  }
+  // one three-way partitioning around both pivots
+  const dual_pivot_classifier< pivot_type<FwdIt>, Compare > classify{ *first, *(last - 1),
+                                                                      cmp };
+  FwdIt middle1, middle2;
+  std::tie( middle1, middle2 ) =
+    ppartition3< BlockSize, Kernel >( first + 1, last - 1, classify, 1, true );
+  place_pivots( first, last, middle1, middle2 );
+  // all elements lie between the pivots, e.g. only two distinct values:
+  // the standard quicksort excludes the elements equal to its pivot
+  if( middle1 == first && middle2 == last )
+  {
+    quicksort< BlockSize, Kernel >( first, last, cmp, depth );
+    return;
+  }
+  const long distance1 = std::distance( first, middle1 );
+  const long distance2 = std::distance( middle1, middle2 );
+  const long distance3 = std::distance( middle2, last );
+  if( bad_partitioning( distance1, distance ) || bad_partitioning( distance2, distance ) ||
+      bad_partitioning( distance3, distance ) )
+  {
+    ppq::stats_add( &ppq::stats::bad_partitions, 1 );
+    break_patterns( first, middle1 );
+    break_patterns( middle1, middle2 );
+    break_patterns( middle2, last );
+  }
+  quicksort_dual_pivot< BlockSize, Kernel >( first, middle1, cmp, depth - 1 );
+  quicksort_dual_pivot< BlockSize, Kernel >( middle1, middle2, cmp, depth - 1 );
+  quicksort_dual_pivot< BlockSize, Kernel >( middle2, last, cmp, depth - 1 );
+}
+
+// work-stealing scheduler of pquicksort and pquicksort_dual_pivot
+// every thread of the team runs a worker with its own deque of subarrays
+// - a worker partitions its subarray, pushes the larger parts to the bottom
+//   of its deque and continues with the smallest part, so the continuation
+//   with the most work is the one left to steal
+// - idle workers steal the oldest subarray from the top of other deques
+// - subarrays of at least ws_partition_threshold elements are partitioned
+//   blockwise, idle workers join the partitioning and claim blocks like
+//   the threads of parallel_phase
+// - subarrays of at most ws_sequential_threshold elements are sorted by
+//   one worker
+// there is no barrier per level, the workers stop when no subarray is left
+
+// subarrays up to this size are sorted by one worker
+constexpr long ws_sequential_threshold = 1L << 12;
+// subarrays from this size are partitioned together with idle workers
+constexpr long ws_partition_threshold = 1L << 16;
+
+// busy and wall time of a work-stealing sort
+// busy time = time spent sorting, partitioning and helping, summed over
+// all workers
+struct sort_utilization
+{
+  int threads = 0;
+  double wall_seconds = 0;
+  double busy_seconds = 0;
+  // fraction of the available thread time the workers were busy
+  double ratio() const
+  {
+    return ( threads * wall_seconds > 0 ) ? busy_seconds / ( threads * wall_seconds ) : 0;
+  }
+};
+
+// spin lock of the work-stealing deques, held only for a push or pop
+class spin_lock
+{
+public:
+  void lock()
+  {
+    while( locked.exchange( true, std::memory_order_acquire ) )
+      while( locked.load( std::memory_order_relaxed ) ) std::this_thread::yield();
+  }
+  void unlock() { locked.store( false, std::memory_order_release ); }
+private:
+  std::atomic<bool> locked{ false };
+};
+
+// blockwise partitioning of one worker which idle workers can join
+// state = open bit and the number of joined workers, a worker can only join
+// while the partitioning is open, the owner closes it and waits until all
+// joined workers left before the job is destroyed
+class shared_partitioning
+{
+public:
+  // the owner takes slot 0
+  void open( void *job, void (*work)( void*, int ) )
+  {
+    this->job = job;
+    this->work = work;
+    slots.store( 1, std::memory_order_relaxed );
+    state.store( open_bit, std::memory_order_release );
+  }
+
+  void close()
+  {
+    state.fetch_sub( open_bit );
+    while( state.load( std::memory_order_acquire ) != 0 ) std::this_thread::yield();
+  }
+
+  // runs the job on a free slot below capacity, false if not open
+  bool help( const int capacity )
+  {
+    long s = state.load( std::memory_order_relaxed );
+    do
+    {
+      if( s < open_bit ) return false;
+    } while( !state.compare_exchange_weak( s, s + 1 ) );
+    const int slot = slots.fetch_add( 1 );
+    if( slot < capacity ) work( job, slot );
+    state.fetch_sub( 1, std::memory_order_release );
+    return true;
+  }
+
+private:
+  static constexpr long open_bit = 1L << 32;
+  std::atomic<long> state{ 0 };
+  std::atomic<int> slots{ 0 };
+  void *job = nullptr;
+  void (*work)( void*, int ) = nullptr;
+};
+
+// calls the type-erased job of a shared_partitioning
+template< class Job >
+inline void call_job( void *job, const int slot )
+{
+  (*static_cast<Job*>( job ))( slot );
+}
+
+// Step = step( scheduler, tid, range ), partitions the range, pushes parts
+// with scheduler.push and returns true to continue with the part left in
+// range or sorts the range and returns false
+template< class FwdIt, class Step >
+class ws_scheduler
+{
+public:
+  struct range
+  {
+    FwdIt first, last;
+    int depth;
+    // characters shared by the strings of the subarray, pstring_sort only
+    long offset = 0;
+  };
+
+  // the whole array is the first subarray of worker 0
+  ws_scheduler( const int threads, const Step step, const FwdIt first,
+                const FwdIt last )
+    : threads( threads ), step( step ), workers( threads ),
+      scratch_bytes( ppq::sort_scratch_bytes<FwdIt>( std::distance( first, last ), threads ) )
+  {
+    const int depth = introsort_depth( std::distance( first, last ) );
+    ppq::stats_depth_limit( depth );
+    workers[0].ranges.push_back( { first, last, depth } );
+  }
+
+  // worker loop, called by every thread of the team
+  void run( const int tid )
+  {
+    ppq::reserve_scratch( scratch_bytes );
+    using clock = std::chrono::steady_clock;
+    const auto start = clock::now();
+    auto &self = workers[tid];
+    unsigned seed = tid + 1;
+    range r;
+    while( pending.load() > 0 )
+    {
+      const auto busy_start = clock::now();
+      if( pop( tid, r ) || steal( tid, seed, r ) )
+      {
+        while( step( *this, tid, r ) ) {}
+        pending.fetch_sub( 1 );
+      }
+      else if( !help( tid ) )
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      self.busy += std::chrono::duration<double>( clock::now() - busy_start ).count();
+    }
+    self.wall = std::chrono::duration<double>( clock::now() - start ).count();
+  }
+
+  // pushes a subarray to the bottom of the deque of worker tid
+  void push( const int tid, const range &r )
+  {
+    pending.fetch_add( 1 );
+    ppq::stats_add( &ppq::stats::pushed_ranges, 1 );
+    std::lock_guard<spin_lock> lock( workers[tid].lock );
+    workers[tid].ranges.push_back( r );
+  }
+
+  // partitions [first, last) by pred, idle workers may join
+  template< class Kernel, class Predicate >
+  FwdIt partition( const int tid, const FwdIt first, const FwdIt last,
+                   const Predicate pred, const long B )
+  {
+    const long N = std::distance( first, last );
+    if( threads == 1 || N < ws_partition_threshold || N < 2 * B )
+      return spartition< Kernel >( first, last, pred );
+    auto &shared = workers[tid].partitioning;
+    if( numa_mode( N, threads ) )
+    {
+      ppq::scratch_frame frame;
+      numa_partitioning< Kernel, FwdIt, Predicate > partitioning( frame, first, last, pred,
+                                                                  threads, B );
+      auto work = [&]( const int slot ) { partitioning.work( slot ); };
+      {
+        const ppq::stats_timer timer( ppq::parallel_phase_time );
+        shared.open( &work, &call_job< decltype( work ) > );
+        work( 0 );
+        shared.close();
+      }
+      partitioning.prepare_exchange();
+      auto exchange = [&]( const int ) { partitioning.exchange(); };
+      const ppq::stats_timer timer( ppq::swapping_time );
+      shared.open( &exchange, &call_job< decltype( exchange ) > );
+      exchange( 0 );
+      shared.close();
+      ppq::stats_partition( threads, 0 );
+      return partitioning.border();
+    }
+    std::atomic<int> numRemainingBlocks( N / B );
+    std::atomic<int> i( 0 );
+    std::atomic<int> j( 1 );
+    ppq::scratch_frame frame;
+    long *remainingBlocks = frame.take<long>( threads );
+    std::fill( remainingBlocks, remainingBlocks + threads, N );
+    auto job = [&]( const int slot )
+    {
+      neutralize_claimed_blocks< Kernel >( first, last, pred, numRemainingBlocks,
+                                           i, j, B, remainingBlocks[slot] );
+    };
+    {
+      const ppq::stats_timer timer( ppq::parallel_phase_time );
+      shared.open( &job, &call_job< decltype( job ) > );
+      job( 0 );
+      shared.close();
+    }
+    return parallel_cleanup< Kernel >( first, last, pred, threads, i.load(),
+                                       remainingBlocks, B );
+  }
+
+  // partitions [first, last) into the three groups of classify in one pass,
+  // idle workers may join, see block_partitioning3
+  // returns the first element of the middle and of the right-side group
+  template< long BlockSize, class Kernel, class Classifier >
+  std::pair< FwdIt, FwdIt > partition3( const int tid, const FwdIt first, const FwdIt last,
+                                        const Classifier &classify, const long B )
+  {
+    const long N = std::distance( first, last );
+    // the NUMA mode keeps its segments for both passes
+    if( numa_mode( N, threads ) )
+    {
+      const FwdIt middle1 = partition< Kernel >( tid, first, last, classify.lower(), B );
+      return { middle1, partition< Kernel >( tid, middle1, last, classify.upper(), B ) };
+    }
+    if( threads == 1 || N < ws_partition_threshold || N < 2 * B )
+      return partition3_phases< BlockSize, Kernel >( first, last, classify, 1 );
+    auto &shared = workers[tid].partitioning;
+    ppq::scratch_frame frame;
+    block_partitioning3< BlockSize, Kernel, FwdIt, Classifier > partitioning( frame, first, last,
+                                                                              classify, threads, B );
+    auto work = [&]( const int slot ) { partitioning.work( slot ); };
+    {
+      const ppq::stats_timer timer( ppq::parallel_phase_time );
+      shared.open( &work, &call_job< decltype( work ) > );
+      work( 0 );
+      shared.close();
+    }
+    partitioning.prepare_exchange( threads );
+    auto exchange = [&]( const int ) { partitioning.exchange(); };
+    {
+      const ppq::stats_timer timer( ppq::swapping_time );
+      shared.open( &exchange, &call_job< decltype( exchange ) > );
+      exchange( 0 );
+      shared.close();
+    }
+    return partitioning.complete();
+  }
+
+  // runs fn( begin, end ) on blocks of [0, n), idle workers may join
+  template< class Fn >
+  void parallel_for( const int tid, const long n, const long block, const Fn &fn )
+  {
+    if( threads == 1 || n < ws_partition_threshold ) return fn( 0, n );
+    std::atomic<long> next( 0 );
+    auto job = [&]( const int )
+    {
+      for( long begin; ( begin = next.fetch_add( block ) ) < n; )
+        fn( begin, std::min( begin + block, n ) );
+    };
+    auto &shared = workers[tid].partitioning;
+    shared.open( &job, &call_job< decltype( job ) > );
+    job( 0 );
+    shared.close();
+  }
+
+  // utilization of the workers which took part
+  sort_utilization utilization() const
+  {
+    sort_utilization result;
+    for( const auto &worker : workers )
+    {
+      if( worker.wall == 0 ) continue;
+      ++result.threads;
+      result.busy_seconds += worker.busy;
+      result.wall_seconds = std::max( result.wall_seconds, worker.wall );
+    }
+    return result;
+  }
+
+private:
+  // one cache line per worker
+  struct alignas( 64 ) worker
+  {
+    spin_lock lock;
+    std::deque< range > ranges;
+    shared_partitioning partitioning;
+    double busy = 0;
+    double wall = 0;
+  };
+
+  bool pop( const int tid, range &r )
+  {
+    auto &self = workers[tid];
+    std::lock_guard<spin_lock> lock( self.lock );
+    if( self.ranges.empty() ) return false;
+    r = self.ranges.back();
+    self.ranges.pop_back();
+    return true;
+  }
+
+  // tries all other workers once, starting at a random one
+  bool steal( const int tid, unsigned &seed, range &r )
+  {
+    seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+    for( int k = 0; k < threads; ++k )
+    {
+      auto &victim = workers[ (seed + k) % threads ];
+      if( &victim == &workers[tid] ) continue;
+      std::lock_guard<spin_lock> lock( victim.lock );
+      if( victim.ranges.empty() ) continue;
+      r = victim.ranges.front();
+      victim.ranges.pop_front();
+      ppq::stats_add( &ppq::stats::stolen_ranges, 1 );
+      return true;
+    }
+    return false;
+  }
+
+  // joins an open partitioning of another worker
+  bool help( const int tid )
+  {
+    for( int k = 1; k < threads; ++k )
+      if( workers[ (tid + k) % threads ].partitioning.help( threads ) ) return true;
+    return false;
+  }
+
+  const int threads;
+  const Step step;
+  std::vector< worker > workers;
+  // scratch space reserved by every worker
+  const std::size_t scratch_bytes;
+  // subarrays in the deques or in progress
+  std::atomic<long> pending{ 1 };
+};
+
+// step of pquicksort for the work-stealing scheduler
+template< long BlockSize, class Kernel, class Compare >
+struct quicksort_step
+{
+  Compare cmp;
+
+  template< class Scheduler, class Range >
+  bool operator()( Scheduler &scheduler, const int tid, Range &r ) const
+  {
+    using FwdIt = decltype( r.first );
+    using T = typename std::iterator_traits<FwdIt>::value_type;
+    const long distance = std::distance( r.first, r.last );
+    if( distance <= ws_sequential_threshold )
+    {
+      quicksort< BlockSize, Kernel >( r.first, r.last, cmp, r.depth );
+      return false;
+    }
+    ppq::stats_depth( r.depth );
+    if( r.depth == 0 )
+    {
+      merge_sort( r.first, r.last, cmp );
+      return false;
+    }
+    const long B = block_size< BlockSize, T >();
+    pivot_to_front( r.first, r.last, cmp );
+    const pivot_classifier< pivot_type<FwdIt>, Compare > classify{ *r.first, cmp };
+    const auto middles =
+      scheduler.template partition3< BlockSize, Kernel >( tid, r.first + 1, r.last, classify, B );
+    FwdIt middle1 = middles.first;
+    const FwdIt middle2 = middles.second;
+    place_pivot( r.first, middle1 );
+
+    const long distance1 = std::distance( r.first, middle1 );
+    const long distance2 = std::distance( middle2, r.last );
+    if( bad_partitioning( distance1, distance ) || bad_partitioning( distance2, distance ) )
+    {
+      ppq::stats_add( &ppq::stats::bad_partitions, 1 );
+      break_patterns( r.first, middle1 );
+      break_patterns( middle2, r.last );
+    }
+    // the larger side can be stolen, the smaller side is continued
+    Range left{ r.first, middle1, r.depth - 1 };
+    Range right{ middle2, r.last, r.depth - 1 };
+    if( distance1 > distance2 ) std::swap( left, right );
+    scheduler.push( tid, right );
+    r = left;
+    return true;
+  }
+};
+
+// step of pquicksort_dual_pivot for the work-stealing scheduler
+template< long BlockSize, class Kernel, class Compare >
+struct dual_pivot_step
+{
+  Compare cmp;
+
+  template< class Scheduler, class Range >
+  bool operator()( Scheduler &scheduler, const int tid, Range &r ) const
+  {
+    using FwdIt = decltype( r.first );
+    using T = typename std::iterator_traits<FwdIt>::value_type;
+    const long distance = std::distance( r.first, r.last );
+    if( distance <= ws_sequential_threshold )
+    {
+      quicksort_dual_pivot< BlockSize, Kernel >( r.first, r.last, cmp, r.depth );
+      return false;
+    }
+    ppq::stats_depth( r.depth );
+    if( r.depth == 0 )
+    {
+      merge_sort( r.first, r.last, cmp );
+      return false;
+    }
+    // equal pivots: one step of the standard quicksort
+    if( !pivots_to_ends( r.first, r.last, cmp ) )
+      return quicksort_step< BlockSize, Kernel, Compare >{ cmp }( scheduler, tid, r );
+    const long B = block_size< BlockSize, T >();
+    const dual_pivot_classifier< pivot_type<FwdIt>, Compare > classify{ *r.first,
+                                                                        *(r.last - 1), cmp };
+    const auto middles =
+      scheduler.template partition3< BlockSize, Kernel >( tid, r.first + 1, r.last - 1,
+                                                          classify, B );
+    FwdIt middle1 = middles.first;
+    FwdIt middle2 = middles.second;
+    place_pivots( r.first, r.last, middle1, middle2 );
+    // all elements lie between the pivots
+    if( middle1 == r.first && middle2 == r.last )
+      return quicksort_step< BlockSize, Kernel, Compare >{ cmp }( scheduler, tid, r );
+
+    Range parts[3] = { { r.first, middle1, r.depth - 1 },
+                       { middle1, middle2, r.depth - 1 },
+                       { middle2, r.last, r.depth - 1 } };
+    bool bad = false;
+    for( const auto &part : parts )
+      bad = bad || bad_partitioning( std::distance( part.first, part.last ), distance );
+    if( bad )
+    {
+      ppq::stats_add( &ppq::stats::bad_partitions, 1 );
+      for( const auto &part : parts ) break_patterns( part.first, part.last );
+    }
+    // the larger parts can be stolen, the smallest part is continued
+    std::sort( parts, parts + 3, []( const Range &a, const Range &b )
+    {
+      return std::distance( a.first, a.last ) < std::distance( b.first, b.last );
+    } );
+    scheduler.push( tid, parts[2] );
+    scheduler.push( tid, parts[1] );
+    r = parts[0];
+    return true;
+  }
+};
+
+// parallel quicksort starter
+// utilization = receives the utilization of the workers
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void pquicksort( const FwdIt first, const FwdIt last, const Compare cmp,
+                 sort_utilization &utilization )
+{
+  const int num = team_threads();
+  using Step = quicksort_step< BlockSize, Kernel, Compare >;
+  ws_scheduler< FwdIt, Step > scheduler( num, Step{ cmp }, first, last );
+  bool sorted = false;
+  team_run( num, [&]()
+  {
+#pragma omp single
+    sorted = presorted_sort( first, last, cmp, num );
+    if( !sorted ) scheduler.run( omp_get_thread_num() );
+  } );
+  utilization = scheduler.utilization();
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void pquicksort( const FwdIt first, const FwdIt last,
+                 const Compare cmp = Compare{} )
+{
+  sort_utilization utilization;
+  pquicksort< BlockSize, Kernel >( first, last, cmp, utilization );
+}
+
+// parallel dual pivot quicksort starter
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void pquicksort_dual_pivot( const FwdIt first, const FwdIt last,
+                            const Compare cmp = Compare{} )
+{
+  const int num = team_threads();
+  using Step = dual_pivot_step< BlockSize, Kernel, Compare >;
+  ws_scheduler< FwdIt, Step > scheduler( num, Step{ cmp }, first, last );
+  bool sorted = false;
+  team_run( num, [&]()
+  {
+#pragma omp single
+    sorted = presorted_sort( first, last, cmp, num );
+    if( !sorted ) scheduler.run( omp_get_thread_num() );
+  } );
+}
+
+// psamplesort: parallel in-place samplesort (IPS4o)
+// every recursion level distributes the elements to up to 256 buckets in one
+// pass with multiway_partition, so O(log_k n) passes over memory are needed
+// instead of O(log_2 n) passes of quicksort
+
+// arrays smaller than samplesort_base_case blocks are sorted by quicksort
+constexpr long samplesort_base_case = 16;
+// maximum number of buckets per recursion level is 2^samplesort_log_buckets
+constexpr int samplesort_log_buckets = 8;
+
+// elements per buffer block of samplesort
+// BlockSize = 0 selects 2 KiB worth of elements
+template< long BlockSize, class T >
+inline long samplesort_block_size()
+{
+  if( BlockSize > 0 ) return BlockSize;
+  const long size = 2048 / static_cast<long>( sizeof(T) );
+  return size < 1 ? 1 : size;
+}
+
+// classifies elements with a binary tree of splitters (Eytzinger layout)
+// equal_buckets = every splitter gets an own bucket for equal elements,
+//                 used if the sample contains duplicate splitters
+template< class T, class Compare >
+struct splitter_classifier
+{
+  std::vector<T> tree;
+  std::vector<T> splitters;
+  Compare cmp;
+  int log_buckets;
+  bool equal_buckets;
+
+  int buckets() const { return ( 1 << log_buckets ) * ( equal_buckets ? 2 : 1 ); }
+
+  int operator()( const T &elem ) const
+  {
+    std::size_t j = 1;
+    for( int l = 0; l < log_buckets; ++l )
+      j = 2 * j + static_cast<std::size_t>( cmp( tree[j], elem ) );
+    const int bucket = static_cast<int>( j ) - ( 1 << log_buckets );
+    if( !equal_buckets ) return bucket;
+    const bool equal = ( bucket < static_cast<int>( splitters.size() ) ) &&
+                       !cmp( elem, splitters[bucket] );
+    return 2 * bucket + equal;
+  }
+
+  // fills the tree with the sorted splitters in [lo, hi)
+  void build( const std::vector<T> &sorted, const std::size_t j,
+              const int lo, const int hi )
+  {
+    if( lo >= hi ) return;
+    const int mid = ( lo + hi ) / 2;
+    tree[j] = sorted[mid];
+    build( sorted, 2 * j, lo, mid );
+    build( sorted, 2 * j + 1, mid + 1, hi );
+  }
+};
+
+// draws a random sample, moves it to the front of the array and
+// selects 2^log_buckets - 1 splitters
+template< class FwdIt, class Compare >
+inline splitter_classifier< typename std::iterator_traits<FwdIt>::value_type, Compare >
+sample_splitters( const FwdIt first, const FwdIt last, const Compare cmp,
+                  const int log_buckets )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  const long n = last - first;
+  const long k = 1L << log_buckets;
+  // oversampling factor 0.2 * log2(n) as proposed for IPS4o
+  long oversampling = static_cast<long>( 0.2 * std::log2( static_cast<double>( n ) ) );
+  if( oversampling < 1 ) oversampling = 1;
+  const long sample_size = ( oversampling * k < n ) ? oversampling * k : n;
+
+  // xorshift generator, seeded with the array size
+  unsigned long long state = static_cast<unsigned long long>( n ) * 0x9E3779B97F4A7C15ull + 1;
+  for( long i = 0; i < sample_size; ++i )
+  {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    std::iter_swap( first + i, first + i + static_cast<long>( state % ( n - i ) ) );
+  }
+  quicksort< 0, branchless_kernel >( first, first + sample_size, cmp );
+
+  splitter_classifier< T, Compare > classifier{ {}, {}, cmp, log_buckets, false };
+  for( long i = 1; i < k; ++i )
+  {
+    const T &splitter = *(first + i * sample_size / k);
+    if( classifier.splitters.empty() || cmp( classifier.splitters.back(), splitter ) )
+      classifier.splitters.push_back( splitter );
+  }
+  classifier.equal_buckets = static_cast<long>( classifier.splitters.size() ) < k - 1;
+
+  std::vector<T> padded( classifier.splitters );
+  padded.resize( k - 1, classifier.splitters.back() );
+  classifier.tree.resize( k );
+  classifier.build( padded, 1, 0, k - 1 );
+  return classifier;
+}
+
+// samplesort, per default single threaded
+// launch with psamplesort to run in parallel
+// BlockSize = elements per buffer block, 0 selects 2 KiB worth of elements
+// num = number of threads, only for intern use
+template< long BlockSize = 0, class FwdIt, class Compare = std::less<> >
+void samplesort( const FwdIt first, const FwdIt last,
+                 const Compare cmp = Compare{},
+                 const int num = 1 )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  const long b = samplesort_block_size< BlockSize, T >();
+  const long n = std::distance( first, last );
+  // quicksort is faster for small arrays
+  if( n < samplesort_base_case * b )
+  {
+    quicksort< 0, branchless_kernel >( first, last, cmp );
+    return;
+  }
+  // at least 4 blocks per bucket
+  int log_buckets = 2;
+  while( log_buckets < samplesort_log_buckets &&
+         ( 4 * b << (log_buckets + 1) ) <= n )
+    ++log_buckets;
+
+  const auto classifier = sample_splitters( first, last, cmp, log_buckets );
+  const int k = classifier.buckets();
+  std::vector<long> bucket_begin( k + 1 );
+  multiway_partition( first, last, classifier, k, b, num, bucket_begin.data() );
+
+  // recursive samplesort calls
+  // pragmas are ONLY considered when invoked from parallel samplesort
+  // if bucketsize over 10000, start new tasks
+  for( int i = 0; i < k; ++i )
+  {
+    // equal buckets are sorted already
+    if( classifier.equal_buckets && i % 2 == 1 ) continue;
+    const long size = bucket_begin[i+1] - bucket_begin[i];
+    if( size < 2 ) continue;
+    // distributs cores according to remaining work
+    int new_num = static_cast<int>( num * size / n );
+    if( new_num < 1 ) new_num = 1;
+    const FwdIt bucket_first = first + bucket_begin[i];
+    const FwdIt bucket_last = first + bucket_begin[i+1];
+#pragma omp task if( size > 10000 ) firstprivate( bucket_first, bucket_last, new_num )
+    samplesort< BlockSize >( bucket_first, bucket_last, cmp, new_num );
+  }
+#pragma omp taskwait
+}
+
+// parallel samplesort starter
+template< long BlockSize = 0, class FwdIt, class Compare = std::less<> >
+void psamplesort( const FwdIt first, const FwdIt last,
+                  const Compare cmp = Compare{} )
+{
+  const int num = team_threads();
+  team_run( num, [&]()
+  {
+#pragma omp single
+    if( !presorted_sort( first, last, cmp, num ) )
+      samplesort< BlockSize >( first, last, cmp, num );
+  } );
+}
+
+// pradix_sort: parallel LSD radix sort for arithmetic keys
+// every pass counts the digits of one chunk per thread, computes the scatter
+// offsets by a prefix sum over all threads and scatters stably into a buffer
+// passes in which all elements share the same digit are skipped
+
+// number of bits sorted per pass
+constexpr int radix_bits = 8;
+constexpr long radix_buckets = 1L << radix_bits;
+// arrays smaller than this are sorted by std::sort
+constexpr long radix_sort_threshold = 4096;
+
+// default key of pradix_sort: the element itself
+struct radix_identity
+{
+  template< class T >
+  constexpr const T& operator()( const T& x ) const { return x; }
+};
+
+// unsigned integer with the same size as Key
+template< class Key, class = void >
+struct radix_unsigned { using type = std::make_unsigned_t<Key>; };
+
+template< class Key >
+struct radix_unsigned< Key, std::enable_if_t<std::is_floating_point_v<Key>> >
+{
+  static_assert( sizeof(Key) == 4 || sizeof(Key) == 8,
+                 "pradix_sort supports float and double keys only" );
+  using type = std::conditional_t< sizeof(Key) == 4, std::uint32_t, std::uint64_t >;
+};
+
+// maps a key to an unsigned integer with the same order
+// signed integers: flip the sign bit
+// floating point:  flip all bits of negative numbers, the sign bit otherwise
+template< class Key >
+inline auto radix_key( const Key key )
+{
+  static_assert( std::is_arithmetic_v<Key> && !std::is_same_v<Key, bool>,
+                 "the key of pradix_sort has to be an integer or floating point type" );
+  using U = typename radix_unsigned<Key>::type;
+  constexpr U sign = U(1) << ( sizeof(U) * 8 - 1 );
+  if constexpr( std::is_floating_point_v<Key> )
+  {
+    U bits;
+    std::memcpy( &bits, &key, sizeof(U) );
+    return static_cast<U>( bits ^ ( (bits & sign) ? U(~U(0)) : sign ) );
+  }
+  else if constexpr( std::is_signed_v<Key> )
+    return static_cast<U>( static_cast<U>(key) ^ sign );
+  else
+    return static_cast<U>( key );
+}
+
+// one pass of the radix sort, called by every thread of the team
+// [src + begin, src + end) is the chunk of the calling thread
+// counts = radix_buckets counters per thread, skip is set if all elements
+// share the same digit
+template< class SrcIt, class DstIt, class KeyFn >
+inline void radix_pass( const SrcIt src, const DstIt dst,
+                        const long begin, const long end, const int shift,
+                        const KeyFn& key, long *counts, bool& skip,
+                        const int tid, const int num, const long n )
+{
+  long *count = counts + tid * radix_buckets;
+  std::fill( count, count + radix_buckets, 0 );
+  for( long i = begin; i < end; ++i )
+    ++count[ ( radix_key( key( src[i] ) ) >> shift ) & ( radix_buckets - 1 ) ];
+#pragma omp barrier
+#pragma omp single
+  {
+    // exclusive prefix sum over (digit, thread)
+    long sum = 0;
+    skip = false;
+    for( long d = 0; d < radix_buckets; ++d )
+    {
+      long digit_sum = 0;
+      for( int t = 0; t < num; ++t )
+      {
+        const long c = counts[t * radix_buckets + d];
+        counts[t * radix_buckets + d] = sum;
+        sum += c;
+        digit_sum += c;
+      }
+      if( digit_sum == n ) skip = true;
+    }
+  }
+  if( skip ) return;
+  for( long i = begin; i < end; ++i )
+  {
+    auto& x = src[i];
+    dst[ count[ ( radix_key( key( x ) ) >> shift ) & ( radix_buckets - 1 ) ]++ ] = std::move( x );
+  }
+#pragma omp barrier
+}
+
+// parallel radix sort
+// key = maps an element to an integer or floating point key (default: the
+//       element itself), the elements are sorted ascending by this key
+// num = number of threads
+// the sort is stable, needs a buffer of the size of the array and the
+// value type has to be default constructible
+template< class FwdIt, class KeyFn = radix_identity >
+void pradix_sort( const FwdIt first, const FwdIt last,
+                  const KeyFn key = KeyFn{},
+                  const int num = omp_get_max_threads() )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  using Key = std::decay_t< decltype( key( *first ) ) >;
+  const long n = std::distance( first, last );
+  if( n < radix_sort_threshold )
+  {
+    std::stable_sort( first, last, [&key]( const T& a, const T& b )
+                      { return radix_key( key( a ) ) < radix_key( key( b ) ); } );
+    return;
+  }
+  constexpr int passes = static_cast<int>( sizeof(Key) * 8 ) / radix_bits;
+  std::vector<T> buffer( n );
+  std::vector<long> counts( num * radix_buckets );
+  bool skip = false;
+  bool in_buffer = false;
+
+  team_run( num, [&]()
+  {
+    const int tid = omp_get_thread_num();
+    const int threads = omp_get_num_threads();
+    const long begin = n * tid / threads;
+    const long end = n * (tid + 1) / threads;
+    for( int pass = 0; pass < passes; ++pass )
+    {
+      if( in_buffer )
+        radix_pass( buffer.begin(), first, begin, end, pass * radix_bits, key,
+                    counts.data(), skip, tid, threads, n );
+      else
+        radix_pass( first, buffer.begin(), begin, end, pass * radix_bits, key,
+                    counts.data(), skip, tid, threads, n );
+      // every thread has seen skip here, flip in_buffer once
+#pragma omp single
+      if( !skip ) in_buffer = !in_buffer;
+    }
+    if( in_buffer )
+      std::move( buffer.begin() + begin, buffer.begin() + end, first + begin );
+  } );
+}
+
+// batched quickselect for several ranks in one recursive pass
+// every partitioning step splits the sorted ranks at the borders, only the
+// parts with ranks left are selected further, as tasks like quicksort
+// begin = first element of the whole array, the ranks are relative to it
+// num = number of threads, only for intern use
+// depth = remaining levels until the range is sorted by merge_sort, only for
+//         intern use, -1 selects 2*log2(n)
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class RankIt, class Compare >
+void quickselect_multi( const FwdIt begin, const FwdIt first, const FwdIt last,
+                        const RankIt ranks_first, const RankIt ranks_last,
+                        const Compare cmp, const int num = 1, int depth = -1 )
+{
+  if( ranks_first == ranks_last ) return;
+  const long distance = std::distance( first, last );
+  if( distance <= 32 )
+  {
+    insertion_sort( first, last, cmp );
+    return;
+  }
+  if( depth < 0 ) depth = introsort_depth( distance );
+  if( depth == 0 )
+  {
+    merge_sort( first, last, cmp, num );
+    return;
+  }
+  pivot_to_front( first, last, cmp );
+  const pivot_classifier< pivot_type<FwdIt>, Compare > classify{ *first, cmp };
+  FwdIt middle1, middle2;
+  std::tie( middle1, middle2 ) =
+    ppartition3< BlockSize, Kernel >( first + 1, last, classify, num, true );
+  place_pivot( first, middle1 );
+
+  // the ranks between the borders hit elements equal to the pivot
+  const RankIt ranks1 = std::lower_bound( ranks_first, ranks_last,
+                                          std::distance( begin, middle1 ) );
+  const RankIt ranks2 = std::lower_bound( ranks1, ranks_last,
+                                          std::distance( begin, middle2 ) );
+
+  // distributs cores according to remaining work
+  int new_num1 = num;
+  int new_num2 = num;
+  const long distance1 = ( ranks_first == ranks1 ) ? 0 : std::distance( first, middle1 );
+  const long distance2 = ( ranks2 == ranks_last ) ? 0 : std::distance( middle2, last );
+  if( num > 1 && distance1 + distance2 > 0 )
+  {
+    const float share = 1.0 * distance1 / ( distance1 + distance2 );
+    new_num1 = ( (int)(share * num) < 1 ) ? 1 : share * num;
+    new_num2 = ( (num - new_num1) < 1 ) ? 1 : num - new_num1;
+  }
+  if( bad_partitioning( distance1, distance ) || bad_partitioning( distance2, distance ) )
+  {
+    ppq::stats_add( &ppq::stats::bad_partitions, 1 );
+    break_patterns( first, middle1 );
+    break_patterns( middle2, last );
+  }
+#pragma omp task if( distance1 > 10000 && distance2 > 0 )
+  quickselect_multi< BlockSize, Kernel >( begin, first, middle1, ranks_first, ranks1,
+                                          cmp, new_num1, depth - 1 );
+  quickselect_multi< BlockSize, Kernel >( begin, middle2, last, ranks2, ranks_last,
+                                          cmp, new_num2, depth - 1 );
+#pragma omp taskwait
+}
+
+// parallel quickselect
+// the batched quickselect with one rank, all levels run in one team
+// depth = remaining levels until the range is sorted by merge_sort, only for
+//         intern use, -1 selects 2*log2(n)
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void pquickselect( const FwdIt first, const FwdIt nth, const FwdIt last,
+                   const Compare cmp = Compare{},
+                   const int num = omp_get_max_threads(), int depth = -1 )
+{
+  if( first == last ) return;
+  const long rank = std::distance( first, nth );
+  const std::size_t scratch = ppq::sort_scratch_bytes<FwdIt>( std::distance( first, last ), num );
+  team_run( num, [&]()
+  {
+    ppq::reserve_scratch( scratch );
+#pragma omp single
+    quickselect_multi< BlockSize, Kernel >( first, first, last, &rank, &rank + 1,
+                                            cmp, num, depth );
+  } );
+}
+
+// places the elements of all ranks like pquickselect does for one nth
+// [ranks_first, ranks_last) = ascending positions relative to first
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class RankIt, class Compare = std::less<> >
+void pquickselect_multi( const FwdIt first, const FwdIt last,
+                         const RankIt ranks_first, const RankIt ranks_last,
+                         const Compare cmp = Compare{},
+                         const int num = omp_get_max_threads() )
+{
+  if( first == last || ranks_first == ranks_last ) return;
+  const std::size_t scratch = ppq::sort_scratch_bytes<FwdIt>( std::distance( first, last ), num );
+  team_run( num, [&]()
+  {
+    ppq::reserve_scratch( scratch );
+#pragma omp single
+    quickselect_multi< BlockSize, Kernel >( first, first, last, ranks_first, ranks_last,
+                                            cmp, num );
+  } );
+}
+// parallel pquickselect as comparison
+template< long BlockSize = 0, class Kernel = scanning_kernel, class FwdIt >
+void pquickselect_iterativ( const FwdIt first, const FwdIt nth, const FwdIt last,
+                            const int num = omp_get_max_threads() )
+{
+  FwdIt left = first;
+  FwdIt right = last;
+  int depth = introsort_depth( std::distance( first, last ) );
+  ppq::reserve_scratch( ppq::sort_scratch_bytes<FwdIt>( std::distance( first, last ), num ) );
+  while ( left < right)
+  {
+    // too many levels: the rest is sorted
+    if( depth-- == 0 )
+    {
+      team_run( num, [&]()
+      {
+#pragma omp single
+        merge_sort( left, right, std::less<>{}, num );
+      } );
+      return;
+    }
+    pivot_to_front( left, right, std::less<>{} );
+    const pivot_classifier< pivot_type<FwdIt>, std::less<> > classify{ *left, {} };
+
+    FwdIt middle1;
+    FwdIt middle2;
+    std::tie( middle1, middle2 ) =
+      ppartition3< BlockSize, Kernel >( left + 1, right, classify, num );
+    place_pivot( left, middle1 );
+
+    if ( nth < middle1 ) right = middle1;
+    else if ( nth >= middle2 ) left = middle2;
+    else return;
+  }
+}
+
+// partial sort and top-k
+// ppartial_sort sorts the k = middle - first smallest elements into
+// [first, middle), the order of the others is unspecified
+// - small k (heap mode): every thread keeps the k smallest elements of its
+//   chunk in a max-heap at the front of the chunk, the num*k candidates are
+//   gathered at the front and partially sorted, O(n + num*k log k)
+// - else: pquickselect cuts the range at middle and the prefix is sorted
+//   by the parallel quicksort, O(n + k log k)
+// num = number of threads, by default the team of the current context like
+// pquicksort, the work-stealing deques are sized by it
+
+// largest k of the heap mode
+constexpr long partial_sort_heap_threshold = 1L << 12;
+
+// compare with swapped arguments, ptop_k selects with it
+template< class Compare >
+struct reversed_compare
+{
+  Compare cmp;
+  template< class A, class B >
+  bool operator()( const A &a, const B &b ) const { return cmp( b, a ); }
+};
+
+// moves the k smallest elements of [first, last) into a max-heap at
+// [first, first + k), k <= last - first
+template< class FwdIt, class Compare >
+inline void heap_select( const FwdIt first, const long k, const FwdIt last,
+                         const Compare cmp )
+{
+  const FwdIt middle = first + k;
+  std::make_heap( first, middle, cmp );
+  for( FwdIt it = middle; it < last; ++it )
+    if( cmp( *it, *first ) )
+    {
+      std::pop_heap( first, middle, cmp );
+      std::iter_swap( it, middle - 1 );
+      std::push_heap( first, middle, cmp );
+    }
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void ppartial_sort( const FwdIt first, const FwdIt middle, const FwdIt last,
+                    const Compare cmp = Compare{},
+                    const int num = team_threads() )
+{
+  const long n = std::distance( first, last );
+  const long k = std::distance( first, middle );
+  if( k <= 0 ) return;
+
+  // every chunk holds at least 2k elements, so the gathered heaps never
+  // overlap chunks which are still to be moved
+  if( k <= partial_sort_heap_threshold && 2 * k * num <= n )
+  {
+    std::vector<long> begins( num + 1 );
+    int threads = num;
+    team_run( num, [&]()
+    {
+#pragma omp single
+      {
+        threads = omp_get_num_threads();
+        for( int t = 0; t <= threads; ++t ) begins[t] = n * t / threads;
+      }
+      const int tid = omp_get_thread_num();
+      heap_select( first + begins[tid], k, first + begins[tid+1], cmp );
+    } );
+    for( int t = 1; t < threads; ++t )
+      std::swap_ranges( first + begins[t], first + (begins[t] + k), first + t * k );
+    std::partial_sort( first, middle, first + threads * k, cmp );
+    return;
+  }
+
+  if( middle < last )
+    pquickselect< BlockSize, Kernel >( first, middle, last, cmp, num );
+  using Step = quicksort_step< BlockSize, Kernel, Compare >;
+  ws_scheduler< FwdIt, Step > scheduler( num, Step{ cmp }, first, middle );
+  team_run( num, [&]() { scheduler.run( omp_get_thread_num() ); } );
+}
+
+// moves the k largest elements in descending order to the front
+// returns the end of the top-k, first + min( k, last - first )
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+FwdIt ptop_k( const FwdIt first, const FwdIt last, long k,
+              const Compare cmp = Compare{},
+              const int num = team_threads() )
+{
+  k = std::min( k, static_cast<long>( std::distance( first, last ) ) );
+  ppartial_sort< BlockSize, Kernel >( first, first + k, last,
+                                      reversed_compare< Compare >{ cmp }, num );
+  return first + k;
+}
+
+// key-value sort and argsort over structure-of-arrays data
+// zip_iterator iterates over several ranges at once, its reference is a
+// proxy of references into all ranges, so the kernels swap the elements
+// of all ranges together and no array of structs is built
+// by_key compares only the first range, the scans of the kernels read
+// only the keys, the payloads are touched by the swaps
+// pquicksort_by_key sorts keys and values by the keys, several payload
+// ranges are passed as one make_zip_iterator( ... )
+// pargsort returns the permutation which sorts a range
+
+template< class... Its >
+class zip_iterator;
+
+// reference of zip_iterator, assignments and swaps go through to the
+// elements
+// a proxy is always a temporary, so it cannot tell whether its elements
+// may be moved from: the conversion to value_type and the assignment from
+// another proxy copy, only a value_type is moved in
+template< class... Its >
+class zip_reference
+{
+public:
+  using value_type = std::tuple< typename std::iterator_traits<Its>::value_type... >;
+
+  explicit zip_reference( typename std::iterator_traits<Its>::reference... refs )
+    : refs( refs... ) {}
+  zip_reference( const zip_reference & ) = default;
+
+  zip_reference &operator=( const zip_reference &other )
+  {
+    assign( other.refs, std::index_sequence_for<Its...>{} );
+    return *this;
+  }
+  zip_reference &operator=( const value_type &value )
+  {
+    assign( value, std::index_sequence_for<Its...>{} );
+    return *this;
+  }
+  zip_reference &operator=( value_type &&value )
+  {
+    move_assign( value, std::index_sequence_for<Its...>{} );
+    return *this;
+  }
+
+  operator value_type() const { return copy( std::index_sequence_for<Its...>{} ); }
+
+  // element of range I
+  template< std::size_t I >
+  decltype(auto) get() const { return std::get<I>( refs ); }
+
+  friend void swap( zip_reference a, zip_reference b )
+  {
+    a.swap_elements( b, std::index_sequence_for<Its...>{} );
+  }
+
+private:
+  template< class Tuple, std::size_t... I >
+  void assign( const Tuple &from, std::index_sequence<I...> )
+  {
+    ( ( std::get<I>( refs ) = std::get<I>( from ) ), ... );
+  }
+  template< class Tuple, std::size_t... I >
+  void move_assign( Tuple &from, std::index_sequence<I...> )
+  {
+    ( ( std::get<I>( refs ) = std::move( std::get<I>( from ) ) ), ... );
+  }
+  template< std::size_t... I >
+  value_type copy( std::index_sequence<I...> ) const
+  {
+    return value_type( std::tuple_element_t< I, value_type >( std::get<I>( refs ) )... );
+  }
+  template< std::size_t... I >
+  void swap_elements( zip_reference &other, std::index_sequence<I...> )
+  {
+    using std::swap;
+    ( swap( std::get<I>( refs ), std::get<I>( other.refs ) ), ... );
+  }
+
+  std::tuple< typename std::iterator_traits<Its>::reference... > refs;
+};
+
+// random access iterator over several ranges, the distance of the first
+// range is used for all of them
+template< class... Its >
+class zip_iterator
+{
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::tuple< typename std::iterator_traits<Its>::value_type... >;
+  using difference_type = std::ptrdiff_t;
+  using reference = zip_reference< Its... >;
+  using pointer = void;
+
+  zip_iterator() = default;
+  explicit zip_iterator( const Its... its ) : its( its... ) {}
+
+  reference operator*() const { return dereference( std::index_sequence_for<Its...>{} ); }
+  reference operator[]( const difference_type n ) const { return *( *this + n ); }
+
+  zip_iterator &operator+=( const difference_type n )
+  {
+    advance( n, std::index_sequence_for<Its...>{} );
+    return *this;
+  }
+  zip_iterator &operator-=( const difference_type n ) { return *this += -n; }
+  zip_iterator &operator++() { return *this += 1; }
+  zip_iterator &operator--() { return *this += -1; }
+  zip_iterator operator++( int ) { zip_iterator old( *this ); ++*this; return old; }
+  zip_iterator operator--( int ) { zip_iterator old( *this ); --*this; return old; }
+  zip_iterator operator+( const difference_type n ) const { zip_iterator it( *this ); return it += n; }
+  zip_iterator operator-( const difference_type n ) const { zip_iterator it( *this ); return it -= n; }
+  friend zip_iterator operator+( const difference_type n, const zip_iterator &it ) { return it + n; }
+  difference_type operator-( const zip_iterator &other ) const
+  {
+    return std::get<0>( its ) - std::get<0>( other.its );
+  }
+
+  bool operator==( const zip_iterator &other ) const { return std::get<0>( its ) == std::get<0>( other.its ); }
+  bool operator!=( const zip_iterator &other ) const { return !( *this == other ); }
+  bool operator<( const zip_iterator &other ) const { return std::get<0>( its ) < std::get<0>( other.its ); }
+  bool operator>( const zip_iterator &other ) const { return other < *this; }
+  bool operator<=( const zip_iterator &other ) const { return !( other < *this ); }
+  bool operator>=( const zip_iterator &other ) const { return !( *this < other ); }
+
+private:
+  template< std::size_t... I >
+  reference dereference( std::index_sequence<I...> ) const
+  {
+    return reference( *std::get<I>( its )... );
+  }
+  template< std::size_t... I >
+  void advance( const difference_type n, std::index_sequence<I...> )
+  {
+    ( ( std::get<I>( its ) += n ), ... );
+  }
+
+  std::tuple< Its... > its;
+};
+
+template< class... Its >
+zip_iterator< Its... > make_zip_iterator( const Its... its )
+{
+  return zip_iterator< Its... >( its... );
+}
+
+// element of range I of a zip_reference or its value_type
+template< std::size_t I, class... Its >
+inline decltype(auto) zip_get( const zip_reference< Its... > &ref )
+{
+  return ref.template get<I>();
+}
+
+template< std::size_t I, class... Ts >
+inline const auto &zip_get( const std::tuple< Ts... > &value ) { return std::get<I>( value ); }
+
+// compares the elements of zip_iterators by the first range
+template< class Compare >
+struct by_key
+{
+  Compare cmp;
+  template< class A, class B >
+  bool operator()( const A &a, const B &b ) const { return cmp( zip_get<0>( a ), zip_get<0>( b ) ); }
+};
+
+// sorts [keys_first, keys_last) and moves the values with their keys
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class KeyIt, class ValueIt, class Compare = std::less<> >
+void pquicksort_by_key( const KeyIt keys_first, const KeyIt keys_last,
+                        const ValueIt values_first, const Compare cmp = Compare{} )
+{
+  const auto n = std::distance( keys_first, keys_last );
+  const auto first = make_zip_iterator( keys_first, values_first );
+  pquicksort< BlockSize, Kernel >( first, first + n, by_key< Compare >{ cmp } );
+}
+
+// returns the indices of [first, last) in sorted order, the range is not
+// changed, equal elements keep their order
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+std::vector<long> pargsort( const FwdIt first, const FwdIt last,
+                            const Compare cmp = Compare{} )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  const long n = std::distance( first, last );
+  std::vector<T> keys( n );
+  std::vector<long> index( n );
+  T *key = keys.data();
+  long *idx = index.data();
+  team_run( team_threads(), [&]()
+  {
+#pragma omp for schedule( static )
+    for( long i = 0; i < n; ++i )
+    {
+      key[i] = *(first + i);
+      idx[i] = i;
+    }
+  } );
+  pquicksort_by_key< BlockSize, Kernel >( key, key + n, idx, cmp );
+  // the indices of equal keys are sorted afterwards, every thread takes
+  // the runs starting in its part
+  team_run( team_threads(), [&]()
+  {
+#pragma omp for schedule( static )
+    for( long i = 0; i < n; ++i )
+    {
+      if( i > 0 && !cmp( key[i - 1], key[i] ) ) continue;
+      long end = i + 1;
+      while( end < n && !cmp( key[i], key[end] ) ) ++end;
+      if( end - i > 1 ) std::sort( idx + i, idx + end );
+    }
+  } );
+  return index;
+}
+
+// indirect sort of large records
+// pquicksort moves the records at every recursion level, records of at least
+// PPQ_INDIRECT_SORT_BYTES bytes are therefore sorted by their keys: the keys
+// are extracted next to 32-bit indices ( 64-bit from 2^32 records on ), both
+// arrays are sorted with pquicksort_by_key and every record is moved once
+// 0 switches the indirect sort off
+#ifndef PPQ_INDIRECT_SORT_BYTES
+#define PPQ_INDIRECT_SORT_BYTES 128
+#endif
+constexpr std::size_t indirect_sort_bytes = PPQ_INDIRECT_SORT_BYTES;
+
+// the gather prefetches the record this many positions ahead
+constexpr long indirect_prefetch_distance = 8;
+
+// true if [first, last) is sorted indirectly: large records in memory whose
+// moves do not throw, the proxies of zip_iterator are not records
+template< class FwdIt >
+constexpr bool use_indirect_sort()
+{
+  using Traits = std::iterator_traits<FwdIt>;
+  using T = typename Traits::value_type;
+  return indirect_sort_bytes > 0 && sizeof(T) >= indirect_sort_bytes &&
+         std::is_base_of_v< std::random_access_iterator_tag,
+                            typename Traits::iterator_category > &&
+         std::is_same_v< typename Traits::reference, T& > &&
+         std::is_nothrow_move_constructible_v<T> &&
+         std::is_nothrow_move_assignable_v<T>;
+}
+
+// compares records by their keys
+template< class KeyFn, class Compare >
+struct key_compare
+{
+  KeyFn key;
+  Compare cmp;
+  template< class A, class B >
+  bool operator()( const A &a, const B &b ) const { return cmp( key( a ), key( b ) ); }
+};
+
+// fetches all cache lines of a record
+template< class T >
+inline void prefetch_record( const T *record )
+{
+#if defined( __GNUC__ )
+  const char *bytes = reinterpret_cast<const char*>( record );
+  for( std::size_t line = 0; line < sizeof(T); line += 64 )
+    __builtin_prefetch( bytes + line );
+#else
+  (void)record;
+#endif
+}
+
+// moves the records into the order of index in place: position i receives
+// the record at index[i], every cycle of the permutation is followed once
+// and index becomes the identity
+template< class RandomIt, class Index >
+inline void permute_cycles( const RandomIt first, Index *index, const long n )
+{
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  for( long i = 0; i < n; ++i )
+  {
+    if( index[i] == static_cast<Index>( i ) ) continue;
+    T record( std::move( first[i] ) );
+    long j = i;
+    while( index[j] != static_cast<Index>( i ) )
+    {
+      const long k = index[j];
+      first[j] = std::move( first[k] );
+      index[j] = static_cast<Index>( j );
+      j = k;
+    }
+    first[j] = std::move( record );
+    index[j] = static_cast<Index>( j );
+  }
+}
+
+// moves the records into the order of index: position i receives the record
+// at index[i], e.g. the result of pargsort
+// every thread gathers its chunk of the output into a buffer, prefetching the
+// records ahead, and moves the chunk back after all gathers, so every record
+// is read once at random and written twice sequentially
+// the buffer is taken by the team: the scratch space of the context running
+// the call or an allocated one, without memory for the buffer the cycles are
+// followed in place by one thread, index is changed then
+template< class RandomIt, class Index >
+void papply_permutation( const RandomIt first, Index *index, const long n,
+                         const int num = omp_get_max_threads() )
+{
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  std::allocator<T> allocator;
+  T *buffer = nullptr;
+  bool allocated = false;
+
+  team_run( num, [&]()
+  {
+#pragma omp single
+    {
+      ppq::context *ctx = ppq::context::team();
+      try
+      {
+        allocated = ( ctx == nullptr );
+        buffer = allocated ? allocator.allocate( n )
+                           : static_cast<T*>( ctx->scratch( n * sizeof(T) ) );
+      }
+      catch( const std::bad_alloc& )
+      {
+        allocated = false;
+        permute_cycles( first, index, n );
+      }
+    }
+    if( buffer == nullptr ) return;
+#pragma omp for schedule( static )
+    for( long i = 0; i < n; ++i )
+    {
+      if( i + indirect_prefetch_distance < n )
+        prefetch_record( std::addressof( first[ index[i + indirect_prefetch_distance] ] ) );
+      ::new( static_cast<void*>( buffer + i ) ) T( std::move( first[ index[i] ] ) );
+    }
+#pragma omp for schedule( static )
+    for( long i = 0; i < n; ++i )
+    {
+      first[i] = std::move( buffer[i] );
+      buffer[i].~T();
+    }
+  } );
+  if( allocated ) allocator.deallocate( buffer, n );
+}
+
+template< class Index, long BlockSize, class Kernel,
+          class RandomIt, class KeyFn, class Compare >
+inline void pindirect_sort( const RandomIt first, const long n, const KeyFn &key,
+                            const Compare cmp )
+{
+  using Key = std::decay_t< decltype( key( *first ) ) >;
+  const int num = team_threads();
+  // uninitialized, the threads touch their own part first
+  std::unique_ptr<Key[]> keys( new Key[n] );
+  std::unique_ptr<Index[]> index( new Index[n] );
+  Key *k = keys.get();
+  Index *idx = index.get();
+  team_run( num, [&]()
+  {
+#pragma omp for schedule( static )
+    for( long i = 0; i < n; ++i )
+    {
+      k[i] = key( first[i] );
+      idx[i] = static_cast<Index>( i );
+    }
+  } );
+  pquicksort_by_key< BlockSize, Kernel >( k, k + n, idx, cmp );
+  papply_permutation( first, idx, n, num );
+}
+
+// sorts the records of [first, last) by cmp( key_fn( a ), key_fn( b ) )
+// records of at least indirect_sort_bytes bytes are sorted indirectly
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class KeyFn, class Compare = std::less<> >
+void pquicksort_by( const FwdIt first, const FwdIt last, const KeyFn key_fn,
+                    const Compare cmp = Compare{} )
+{
+  if constexpr( use_indirect_sort<FwdIt>() )
   {
-    middle1 = ppartition(first, last, cmp1, num);
-    middle2 = ppartition(middle1, last, cmp2, num);
+    const long n = std::distance( first, last );
+    if( static_cast<unsigned long>( n ) <= UINT32_MAX )
+      pindirect_sort< std::uint32_t, BlockSize, Kernel >( first, n, key_fn, cmp );
+    else
+      pindirect_sort< std::uint64_t, BlockSize, Kernel >( first, n, key_fn, cmp );
   }
   else
+    pquicksort< BlockSize, Kernel >( first, last, key_compare< KeyFn, Compare >{ key_fn, cmp } );
+}
+
+// pstring_sort: parallel multikey quicksort of strings
+// every string is represented by a ( key, index ) pair in a side array, the
+// key caches the next characters of the string after the offset of its
+// subarray, so the partitioning compares integers and reads no string
+// the pairs are three-way partitioned by their keys with the partitioning of
+// pquicksort: the smaller and the greater part keep the offset, the strings
+// of the middle part share the cached characters, so their keys are refilled
+// from the next offset on, unless the key ends the strings
+// every bucket is a subarray of the work-stealing scheduler, idle threads
+// steal buckets, join large partitionings and refills
+// finally every string is moved once by papply_permutation
+// the strings are ranges of bytes ( std::string, std::string_view, ... ), the
+// order is lexicographic by unsigned characters as of std::string
+
+// characters cached per key, the lowest byte holds their number
+constexpr long string_key_chars = 7;
+// subarrays up to this size are sorted by insertion sort
+constexpr long string_insertion_threshold = 16;
+// strings refilled per block of a parallel refill
+constexpr long string_refill_block = 4096;
+
+// the key of s at offset: the characters from the highest byte on, padded
+// with zeros, and their number, a string shorter than another one with the
+// same characters gets the smaller key
+template< class String >
+inline std::uint64_t string_key( const String &s, const long offset )
+{
+  static_assert( sizeof( *std::data( s ) ) == 1, "pstring_sort sorts strings of bytes" );
+  const unsigned char *chars = reinterpret_cast<const unsigned char*>( std::data( s ) );
+  const long count = std::min( static_cast<long>( std::size( s ) ) - offset, string_key_chars );
+  std::uint64_t key = count;
+  for( long c = 0; c < count; ++c )
+    key |= static_cast<std::uint64_t>( chars[offset + c] ) << ( 56 - 8 * c );
+  return key;
+}
+
+// true if the strings of key go on after its characters
+constexpr bool string_continues( const std::uint64_t key )
+{
+  return static_cast<long>( key & 0xff ) == string_key_chars;
+}
+
+// compares two ( key, index ) pairs of a subarray by their strings from
+// offset on, used for small subarrays and the merge_sort fallback
+template< class RandomIt >
+struct string_compare
+{
+  RandomIt strings;
+  long offset;
+
+  template< class A, class B >
+  bool operator()( const A &a, const B &b ) const
   {
-    middle1 = spartition(first, last, cmp1);
-    middle2 = spartition(middle1, last, cmp2);
+    const std::uint64_t key_a = zip_get<0>( a );
+    const std::uint64_t key_b = zip_get<0>( b );
+    if( key_a != key_b || !string_continues( key_a ) ) return key_a < key_b;
+    const auto &s = strings[ zip_get<1>( a ) ];
+    const auto &t = strings[ zip_get<1>( b ) ];
+    const long from = offset + string_key_chars;
+    const long rest_s = static_cast<long>( std::size( s ) ) - from;
+    const long rest_t = static_cast<long>( std::size( t ) ) - from;
+    const int c = std::memcmp( std::data( s ) + from, std::data( t ) + from,
+                               std::min( rest_s, rest_t ) );
+    return c < 0 || ( c == 0 && rest_s < rest_t );
   }
+};
 
-  // recursive quickselect calls
-  if( nth < middle1 ) pquickselect( first, nth, middle1, cmp, num );
-  else if( nth >= middle2 ) pquickselect( middle2, nth, last, cmp, num );
+// caches the keys of the pairs [first, last) at offset
+template< class ZipIt, class RandomIt >
+inline void string_refill( const ZipIt first, const ZipIt last, const RandomIt strings,
+                           const long offset )
+{
+  for( ZipIt it = first; it != last; ++it )
+    zip_get<0>( *it ) = string_key( strings[ zip_get<1>( *it ) ], offset );
 }
-// parallel pquickselect as comparison
-template< class FwdIt >
-void pquickselect_iterativ( const FwdIt first, const FwdIt nth, const FwdIt last,
-                            const int num = omp_get_max_threads() )
+
+// characters the strings of the pairs [first, last) share with pivot from
+// offset on
+template< class ZipIt, class RandomIt, class String >
+inline long string_common_prefix( const ZipIt first, const ZipIt last, const RandomIt strings,
+                                  const String &pivot, const long offset, long common )
 {
-  FwdIt left = first;
-  FwdIt right = last;
-  while ( left < right)
+  const auto *p = std::data( pivot ) + offset;
+  for( ZipIt it = first; it != last && common > 0; ++it )
   {
-    const auto pivot = medianOfThree(*left, *(left+(right-left)/2), *(right-1));
-    const auto p1 = [pivot](const auto& em){ return em < pivot; };
-    const auto p2 = [pivot](const auto& em){ return em <= pivot; };
+    const auto &s = strings[ zip_get<1>( *it ) ];
+    const long length = std::min( common, static_cast<long>( std::size( s ) ) - offset );
+    common = std::mismatch( p, p + length, std::data( s ) + offset ).first - p;
+  }
+  return common;
+}
 
-    FwdIt middle1;
-    FwdIt middle2;
+// multikey quicksort of the pairs [first, last), single threaded
+// offset = characters shared by the strings, the keys are cached at offset
+// depth = remaining levels until the merge_sort fallback at this offset
+template< class ZipIt, class RandomIt >
+void string_sort( ZipIt first, ZipIt last, const RandomIt strings, long offset, int depth )
+{
+  const by_key< std::less<> > cmp{};
+  while( true )
+  {
+    const long distance = std::distance( first, last );
+    if( distance <= string_insertion_threshold )
+    {
+      insertion_sort( first, last, string_compare< RandomIt >{ strings, offset } );
+      return;
+    }
+    if( depth == 0 )
+    {
+      merge_sort( first, last, string_compare< RandomIt >{ strings, offset } );
+      return;
+    }
+    pivot_to_front( first, last, cmp );
+    const pivot_classifier< pivot_type<ZipIt>, by_key< std::less<> > > classify{ *first, cmp };
+    ZipIt middle1, middle2;
+    std::tie( middle1, middle2 ) = spartition3( first + 1, last, classify );
+    place_pivot( first, middle1 );
+    if( bad_partitioning( std::distance( first, middle1 ), distance ) ||
+        bad_partitioning( std::distance( middle2, last ), distance ) )
+    {
+      ppq::stats_add( &ppq::stats::bad_partitions, 1 );
+      break_patterns( first, middle1 );
+      break_patterns( middle2, last );
+    }
+    string_sort( first, middle1, strings, offset, depth - 1 );
+    string_sort( middle2, last, strings, offset, depth - 1 );
+    // the middle part continues at the next offset, if it is the whole
+    // subarray the common prefix of its strings is skipped at once
+    if( !string_continues( zip_get<0>( *middle1 ) ) ) return;
+    const bool equal = middle1 == first && middle2 == last;
+    first = middle1;
+    last = middle2;
+    offset += string_key_chars;
+    if( equal )
+    {
+      const auto &pivot = strings[ zip_get<1>( *first ) ];
+      offset += string_common_prefix( first, last, strings, pivot, offset,
+                                      static_cast<long>( std::size( pivot ) ) - offset );
+    }
+    string_refill( first, last, strings, offset );
+    depth = introsort_depth( std::distance( first, last ) );
+  }
+}
+
+// step of pstring_sort for the work-stealing scheduler
+template< class RandomIt >
+struct string_sort_step
+{
+  RandomIt strings;
 
-    if ( std::distance(right,left) >= 2*B ){
-      middle1 = ppartition(left, right, p1);
-      middle2 = ppartition(middle1, right, p2);
+  template< class Scheduler, class Range >
+  bool operator()( Scheduler &scheduler, const int tid, Range &r ) const
+  {
+    using ZipIt = decltype( r.first );
+    using T = typename std::iterator_traits<ZipIt>::value_type;
+    const long distance = std::distance( r.first, r.last );
+    if( distance <= ws_sequential_threshold )
+    {
+      string_sort( r.first, r.last, strings, r.offset, r.depth );
+      return false;
     }
-    else {
-      middle1 = spartition(left, right, p1);
-      middle2 = spartition(middle1, right, p2);
+    ppq::stats_depth( r.depth );
+    if( r.depth == 0 )
+    {
+      merge_sort( r.first, r.last, string_compare< RandomIt >{ strings, r.offset } );
+      return false;
     }
+    const by_key< std::less<> > cmp{};
+    const long B = block_size< 0, T >();
+    pivot_to_front( r.first, r.last, cmp );
+    const pivot_classifier< pivot_type<ZipIt>, by_key< std::less<> > > classify{ *r.first, cmp };
+    const auto middles =
+      scheduler.template partition3< 0, scanning_kernel >( tid, r.first + 1, r.last, classify, B );
+    ZipIt middle1 = middles.first;
+    const ZipIt middle2 = middles.second;
+    place_pivot( r.first, middle1 );
 
-    if ( nth < middle1 ) right = middle1;
-    else if ( nth >= middle2 ) left = middle2;
-    else return;
+    const long distance1 = std::distance( r.first, middle1 );
+    const long distance2 = std::distance( middle2, r.last );
+    if( bad_partitioning( distance1, distance ) || bad_partitioning( distance2, distance ) )
+    {
+      ppq::stats_add( &ppq::stats::bad_partitions, 1 );
+      break_patterns( r.first, middle1 );
+      break_patterns( middle2, r.last );
+    }
+    Range parts[3] = { { r.first, middle1, r.depth - 1, r.offset },
+                       { middle2, r.last, r.depth - 1, r.offset },
+                       { middle1, middle2, 0, r.offset + string_key_chars } };
+    int count = 2;
+    // the middle part continues at the next offset, if it is the whole
+    // subarray the common prefix of its strings is skipped at once
+    if( string_continues( zip_get<0>( *middle1 ) ) )
+    {
+      const long distance3 = std::distance( middle1, middle2 );
+      if( distance3 == distance )
+      {
+        const auto &pivot = strings[ zip_get<1>( *middle1 ) ];
+        std::atomic<long> common( static_cast<long>( std::size( pivot ) ) - parts[2].offset );
+        scheduler.parallel_for( tid, distance3, string_refill_block,
+                                [&]( const long begin, const long end )
+        {
+          const long block = string_common_prefix( middle1 + begin, middle1 + end, strings,
+                                                   pivot, parts[2].offset, common.load() );
+          long current = common.load();
+          while( block < current && !common.compare_exchange_weak( current, block ) ) {}
+        } );
+        parts[2].offset += common.load();
+      }
+      scheduler.parallel_for( tid, distance3, string_refill_block,
+                              [&]( const long begin, const long end )
+      {
+        string_refill( middle1 + begin, middle1 + end, strings, parts[2].offset );
+      } );
+      parts[2].depth = introsort_depth( distance3 );
+      count = 3;
+    }
+    // the larger parts can be stolen, the smallest part is continued
+    std::sort( parts, parts + count, []( const Range &a, const Range &b )
+    {
+      return std::distance( a.first, a.last ) < std::distance( b.first, b.last );
+    } );
+    for( int p = count - 1; p > 0; --p ) scheduler.push( tid, parts[p] );
+    r = parts[0];
+    return true;
+  }
+};
+
+template< class Index, class RandomIt >
+inline void pstring_sort( const RandomIt first, const long n )
+{
+  const int num = team_threads();
+  // uninitialized, the threads touch their own part first
+  std::unique_ptr<std::uint64_t[]> keys( new std::uint64_t[n] );
+  std::unique_ptr<Index[]> index( new Index[n] );
+  std::uint64_t *key = keys.get();
+  Index *idx = index.get();
+  const auto pairs = make_zip_iterator( key, idx );
+  using Step = string_sort_step< RandomIt >;
+  ws_scheduler< std::decay_t< decltype( pairs ) >, Step > scheduler( num, Step{ first }, pairs,
+                                                                   pairs + n );
+  bool sorted = false;
+  team_run( num, [&]()
+  {
+#pragma omp single
+    sorted = presorted_sort( first, first + n, std::less<>{}, num );
+    if( sorted ) return;
+#pragma omp for schedule( static )
+    for( long i = 0; i < n; ++i )
+    {
+      key[i] = string_key( first[i], 0 );
+      idx[i] = static_cast<Index>( i );
+    }
+    scheduler.run( omp_get_thread_num() );
+  } );
+  if( !sorted ) papply_permutation( first, idx, n, num );
+}
+
+// sorts the strings of [first, last) lexicographically
+template< class RandomIt >
+void pstring_sort( const RandomIt first, const RandomIt last )
+{
+  const long n = std::distance( first, last );
+  if( n < 2 ) return;
+  if( static_cast<unsigned long>( n ) <= UINT32_MAX )
+    pstring_sort< std::uint32_t >( first, n );
+  else
+    pstring_sort< std::uint64_t >( first, n );
+}
+
+// out-of-core sort of binary record files
+// psort_file sorts a file of fixed-size records by key_fn( record ) with
+// at most about memory bytes of buffers, equal keys keep their order
+// 1. run formation: the file is read in chunks, every chunk is sorted by
+//    pquicksort on ( key, index ) entries, the records are gathered in
+//    this order and written as a run, the next chunk is read and the last
+//    run is written while the current one is sorted
+// 2. k-way merge of the runs: every run is read ahead into a second buffer
+//    and the output is written from a second buffer while the merge goes
+//    on, with more runs than fit into the memory the runs are merged in
+//    several passes
+// the result replaces the file, the runs are written next to it
+// errors of the file operations are thrown as std::runtime_error
+
+// smallest buffer of a run in the merge, limits the runs of one pass
+constexpr std::size_t file_merge_buffer = 1 << 20;
+
+// reads a run sequentially, the next buffer is read asynchronously while
+// the records of the current one are consumed
+class run_reader
+{
+public:
+  run_reader( const std::string &path, const std::size_t record_size,
+              const std::size_t buffer_size )
+    : file( path, std::ios::binary ), record_size( record_size )
+  {
+    if( !file ) throw std::runtime_error( "psort_file: cannot open " + path );
+    for( auto &buffer : buffers ) buffer.resize( buffer_size );
+    read_ahead();
+    next_buffer();
+  }
+
+  // current record, nullptr at the end of the run
+  const char *record() const { return pos < filled ? buffers[current].data() + pos : nullptr; }
+
+  void advance()
+  {
+    pos += record_size;
+    if( pos == filled ) next_buffer();
+  }
+
+private:
+  void read_ahead()
+  {
+    pending = std::async( std::launch::async, [this, next = 1 - current]()
+    {
+      file.read( buffers[next].data(), buffers[next].size() );
+      if( file.bad() ) throw std::runtime_error( "psort_file: cannot read a run" );
+      return static_cast<std::size_t>( file.gcount() );
+    } );
+  }
+
+  void next_buffer()
+  {
+    filled = pending.get();
+    current = 1 - current;
+    pos = 0;
+    if( filled > 0 ) read_ahead();
+  }
+
+  std::ifstream file;
+  const std::size_t record_size;
+  std::vector<char> buffers[2];
+  std::future<std::size_t> pending;
+  int current = 1;
+  std::size_t pos = 0, filled = 0;
+};
+
+// writes records sequentially, a full buffer is written asynchronously
+// while the next one is filled
+class run_writer
+{
+public:
+  run_writer( const std::string &path, const std::size_t buffer_size )
+    : file( path, std::ios::binary | std::ios::trunc )
+  {
+    if( !file ) throw std::runtime_error( "psort_file: cannot create " + path );
+    for( auto &buffer : buffers ) buffer.resize( buffer_size );
+  }
+
+  void put( const char *record, const std::size_t record_size )
+  {
+    if( filled + record_size > buffers[current].size() ) flush();
+    std::memcpy( buffers[current].data() + filled, record, record_size );
+    filled += record_size;
+  }
+
+  // writes [data, data + size) after the buffered records, data must stay
+  // valid until the next call
+  void write_async( const char *data, const std::size_t size )
+  {
+    flush();
+    wait();
+    pending = std::async( std::launch::async, [this, data, size]() { write( data, size ); } );
+  }
+
+  void finish()
+  {
+    flush();
+    wait();
+    file.close();
+    if( !file ) throw std::runtime_error( "psort_file: cannot write" );
+  }
+
+private:
+  void write( const char *data, const std::size_t size )
+  {
+    file.write( data, size );
+    if( !file ) throw std::runtime_error( "psort_file: cannot write" );
+  }
+
+  void wait()
+  {
+    if( pending.valid() ) pending.get();
+  }
+
+  void flush()
+  {
+    if( filled == 0 ) return;
+    wait();
+    pending = std::async( std::launch::async,
+                          [this, buffer = current, size = filled]()
+                          { write( buffers[buffer].data(), size ); } );
+    current = 1 - current;
+    filled = 0;
+  }
+
+  std::ofstream file;
+  std::vector<char> buffers[2];
+  std::future<void> pending;
+  int current = 0;
+  std::size_t filled = 0;
+};
+
+// merges the runs into the file path, ties are taken from the earlier run
+template< class KeyFn >
+void merge_runs_to_file( const std::vector<std::string> &runs, const std::string &path,
+                         const std::size_t record_size, const KeyFn &key_fn,
+                         const std::size_t memory )
+{
+  using Key = std::decay_t< decltype( key_fn( std::declval<const char *>() ) ) >;
+  const std::size_t k = runs.size();
+  // two buffers per run and two for the output
+  const std::size_t buffer_size =
+    std::max( memory / ( 2 * k + 2 ) / record_size, std::size_t( 1 ) ) * record_size;
+  std::vector< std::unique_ptr<run_reader> > readers;
+  for( const auto &run : runs )
+    readers.push_back( std::make_unique<run_reader>( run, record_size, buffer_size ) );
+  run_writer writer( path, buffer_size );
+
+  // min-heap of the runs by ( key, run ), the keys of the heads are cached
+  std::vector<Key> keys( k );
+  std::vector<std::size_t> heap;
+  for( std::size_t r = 0; r < k; ++r )
+    if( readers[r]->record() )
+    {
+      keys[r] = key_fn( readers[r]->record() );
+      heap.push_back( r );
+    }
+  auto greater = [&keys]( const std::size_t a, const std::size_t b )
+  {
+    return keys[b] < keys[a] || ( !( keys[a] < keys[b] ) && b < a );
+  };
+  std::make_heap( heap.begin(), heap.end(), greater );
+  while( !heap.empty() )
+  {
+    const std::size_t r = heap.front();
+    writer.put( readers[r]->record(), record_size );
+    readers[r]->advance();
+    if( readers[r]->record() )
+      keys[r] = key_fn( readers[r]->record() );
+    else
+    {
+      heap.front() = heap.back();
+      heap.pop_back();
+    }
+    // sift down of the new head
+    std::size_t i = 0;
+    const std::size_t size = heap.size();
+    while( 2 * i + 1 < size )
+    {
+      std::size_t child = 2 * i + 1;
+      if( child + 1 < size && greater( heap[child], heap[child + 1] ) ) ++child;
+      if( !greater( heap[i], heap[child] ) ) break;
+      std::swap( heap[i], heap[child] );
+      i = child;
+    }
+  }
+  readers.clear();
+  writer.finish();
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel, class KeyFn >
+void psort_file( const std::string &path, const std::size_t record_size,
+                 const KeyFn key_fn, const std::size_t memory = std::size_t( 1 ) << 30 )
+{
+  using Key = std::decay_t< decltype( key_fn( std::declval<const char *>() ) ) >;
+  using Entry = std::pair< Key, long >;
+  if( record_size == 0 ) throw std::invalid_argument( "psort_file: record_size is 0" );
+
+  std::ifstream input( path, std::ios::binary | std::ios::ate );
+  if( !input ) throw std::runtime_error( "psort_file: cannot open " + path );
+  const std::size_t file_size = input.tellg();
+  input.seekg( 0 );
+  if( file_size % record_size != 0 )
+    throw std::invalid_argument( "psort_file: file size is not a multiple of record_size" );
+  const std::size_t records = file_size / record_size;
+  if( records < 2 ) return;
+
+  // two input buffers, two output buffers and the entries of one chunk
+  const std::size_t chunk_records = std::max< std::size_t >(
+    memory / ( 4 * record_size + sizeof( Entry ) ), 1 );
+  const std::size_t chunk_bytes = chunk_records * record_size;
+  std::vector<char> in[2], out[2];
+  std::vector<Entry> entries;
+  std::vector<std::string> runs;
+
+  // 1. run formation
+  auto read_chunk = [&input, chunk_bytes]( std::vector<char> &buffer )
+  {
+    buffer.resize( chunk_bytes );
+    input.read( buffer.data(), chunk_bytes );
+    if( input.bad() ) throw std::runtime_error( "psort_file: cannot read" );
+    buffer.resize( input.gcount() );
+  };
+  std::future<void> reading = std::async( std::launch::async, read_chunk, std::ref( in[0] ) );
+  std::unique_ptr<run_writer> writers[2];
+  for( std::size_t chunk = 0; chunk * chunk_records < records; ++chunk )
+  {
+    const int c = chunk % 2;
+    reading.get();
+    if( ( chunk + 1 ) * chunk_records < records )
+      reading = std::async( std::launch::async, read_chunk, std::ref( in[1 - c] ) );
+
+    const char *data = in[c].data();
+    const long n = in[c].size() / record_size;
+    entries.resize( n );
+    Entry *entry = entries.data();
+    team_run( team_threads(), [&]()
+    {
+#pragma omp for schedule( static )
+      for( long i = 0; i < n; ++i )
+        entry[i] = Entry( key_fn( data + i * record_size ), i );
+    } );
+    pquicksort< BlockSize, Kernel >( entries.begin(), entries.end() );
+
+    // the buffer of the run before the last one is written
+    if( writers[c] ) writers[c]->finish();
+    out[c].resize( in[c].size() );
+    char *sorted = out[c].data();
+    team_run( team_threads(), [&]()
+    {
+#pragma omp for schedule( static )
+      for( long i = 0; i < n; ++i )
+        std::memcpy( sorted + i * record_size, data + entry[i].second * record_size,
+                     record_size );
+    } );
+    // a single run is written to the file directly
+    const bool single = chunk == 0 && n == static_cast<long>( records );
+    runs.push_back( single ? path + ".sorted" : path + ".run" + std::to_string( chunk ) );
+    writers[c] = std::make_unique<run_writer>( runs.back(), 0 );
+    writers[c]->write_async( sorted, out[c].size() );
+  }
+  for( auto &writer : writers )
+    if( writer ) writer->finish();
+  input.close();
+  std::vector<char>().swap( in[0] );
+  std::vector<char>().swap( in[1] );
+  std::vector<char>().swap( out[0] );
+  std::vector<char>().swap( out[1] );
+  std::vector<Entry>().swap( entries );
+
+  // 2. merge passes, as many runs per pass as get buffers of
+  //    file_merge_buffer bytes
+  const std::size_t fan_in = std::max< std::size_t >(
+    memory / ( 2 * std::max( file_merge_buffer, record_size ) ), 3 ) - 1;
+  for( int pass = 0; runs.size() > 1; ++pass )
+  {
+    std::vector<std::string> merged;
+    for( std::size_t first = 0; first < runs.size(); first += fan_in )
+    {
+      const std::size_t last = std::min( first + fan_in, runs.size() );
+      const std::vector<std::string> group( runs.begin() + first, runs.begin() + last );
+      const std::string target = ( first == 0 && last == runs.size() )
+        ? path + ".sorted"
+        : path + ".pass" + std::to_string( pass ) + "." + std::to_string( merged.size() );
+      if( group.size() == 1 )
+      {
+        if( std::rename( group[0].c_str(), target.c_str() ) != 0 )
+          throw std::runtime_error( "psort_file: cannot rename " + group[0] );
+      }
+      else
+      {
+        merge_runs_to_file( group, target, record_size, key_fn, memory );
+        for( const auto &run : group ) std::remove( run.c_str() );
+      }
+      merged.push_back( target );
+    }
+    runs.swap( merged );
+  }
+  if( std::rename( runs[0].c_str(), path.c_str() ) != 0 )
+    throw std::runtime_error( "psort_file: cannot replace " + path );
+}
+
+// entry points with a ppq::context
+// the team of the context runs all parallel regions of the call, arrays
+// below the serial threshold of the context are handled by the calling
+// thread without the team
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Predicate >
+FwdIt ppartition( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                  const Predicate pred )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return spartition< Kernel >( first, last, pred );
+  const ppq::context::scope use( ctx );
+  return ppartition< BlockSize, Kernel >( first, last, pred, ctx.threads() );
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Classifier >
+std::pair< FwdIt, FwdIt > ppartition3( ppq::context &ctx, const FwdIt first,
+                                       const FwdIt last, const Classifier &classify )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return spartition3< Kernel >( first, last, classify );
+  const ppq::context::scope use( ctx );
+  return ppartition3< BlockSize, Kernel >( first, last, classify, ctx.threads() );
+}
+
+template< class FwdIt, class Predicate >
+FwdIt pstable_partition( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                         const Predicate pred,
+                         typename std::iterator_traits<FwdIt>::value_type *buffer )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return pstable_partition( first, last, pred, buffer, 1 );
+  const ppq::context::scope use( ctx );
+  return pstable_partition( first, last, pred, buffer, ctx.threads() );
+}
+
+// trivial value types use the scratch space of the context as buffer, it is
+// taken by the team, so calls of several threads on one context do not
+// share it ( a call which opens its own team allocates the buffer )
+template< class FwdIt, class Predicate >
+FwdIt pstable_partition( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                         const Predicate pred )
+{
+  using T = typename std::iterator_traits<FwdIt>::value_type;
+  const long n = std::distance( first, last );
+  if( n < ctx.serial_threshold() || !std::is_trivial<T>::value || omp_in_parallel() )
+    return pstable_partition( first, last, pred,
+                              n < ctx.serial_threshold() ? 1 : ctx.threads() );
+  const ppq::context::scope use( ctx );
+  std::unique_ptr<T[]> allocated;
+  return stable_partition_team( first, last, pred, [&allocated]( const long size )
+  {
+    ppq::context *team = ppq::context::team();
+    if( team != nullptr ) return static_cast<T*>( team->scratch( size * sizeof(T) ) );
+    allocated.reset( new T[ size ] );
+    return allocated.get();
+  }, ctx.threads() );
+}
+
+template< class FwdIt, class Predicate >
+FwdIt pstable_partition_inplace( ppq::context &ctx, const FwdIt first,
+                                 const FwdIt last, const Predicate pred )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return pstable_partition_inplace( first, last, pred, 1 );
+  const ppq::context::scope use( ctx );
+  return pstable_partition_inplace( first, last, pred, ctx.threads() );
+}
+
+template< class FwdIt, class Compare = std::less<> >
+bool pis_sorted( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                 const Compare cmp = Compare{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return std::is_sorted( first, last, cmp );
+  const ppq::context::scope use( ctx );
+  return pis_sorted( first, last, cmp, ctx.threads() );
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void pquicksort( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                 const Compare cmp = Compare{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return quicksort< BlockSize, Kernel >( first, last, cmp );
+  const ppq::context::scope use( ctx );
+  pquicksort< BlockSize, Kernel >( first, last, cmp );
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void pquicksort_dual_pivot( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                            const Compare cmp = Compare{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return quicksort_dual_pivot< BlockSize, Kernel >( first, last, cmp );
+  const ppq::context::scope use( ctx );
+  pquicksort_dual_pivot< BlockSize, Kernel >( first, last, cmp );
+}
+
+template< long BlockSize = 0, class FwdIt, class Compare = std::less<> >
+void psamplesort( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                  const Compare cmp = Compare{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return quicksort( first, last, cmp );
+  const ppq::context::scope use( ctx );
+  psamplesort< BlockSize >( first, last, cmp );
+}
+
+template< class FwdIt, class KeyFn = radix_identity >
+void pradix_sort( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                  const KeyFn key = KeyFn{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return pradix_sort( first, last, key, 1 );
+  const ppq::context::scope use( ctx );
+  pradix_sort( first, last, key, ctx.threads() );
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void pquickselect( ppq::context &ctx, const FwdIt first, const FwdIt nth,
+                   const FwdIt last, const Compare cmp = Compare{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+  {
+    const long rank = std::distance( first, nth );
+    return quickselect_multi< BlockSize, Kernel >( first, first, last, &rank,
+                                                   &rank + 1, cmp );
+  }
+  const ppq::context::scope use( ctx );
+  pquickselect< BlockSize, Kernel >( first, nth, last, cmp, ctx.threads() );
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class RankIt, class Compare = std::less<> >
+void pquickselect_multi( ppq::context &ctx, const FwdIt first, const FwdIt last,
+                         const RankIt ranks_first, const RankIt ranks_last,
+                         const Compare cmp = Compare{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return quickselect_multi< BlockSize, Kernel >( first, first, last, ranks_first,
+                                                   ranks_last, cmp );
+  const ppq::context::scope use( ctx );
+  pquickselect_multi< BlockSize, Kernel >( first, last, ranks_first, ranks_last,
+                                           cmp, ctx.threads() );
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+void ppartial_sort( ppq::context &ctx, const FwdIt first, const FwdIt middle,
+                    const FwdIt last, const Compare cmp = Compare{} )
+{
+  if( std::distance( first, last ) < ctx.serial_threshold() )
+    return std::partial_sort( first, middle, last, cmp );
+  const ppq::context::scope use( ctx );
+  ppartial_sort< BlockSize, Kernel >( first, middle, last, cmp, ctx.threads() );
+}
+
+template< long BlockSize = 0, class Kernel = scanning_kernel,
+          class FwdIt, class Compare = std::less<> >
+FwdIt ptop_k( ppq::context &ctx, const FwdIt first, const FwdIt last, long k,
+              const Compare cmp = Compare{} )
+{
+  k = std::min( k, static_cast<long>( std::distance( first, last ) ) );
+  ppartial_sort< BlockSize, Kernel >( ctx, first, first + k, last,
+                                      reversed_compare< Compare >{ cmp } );
+  return first + k;
+}
+
+// execution policies
+// ppq::execution_policy carries the block size and the kernel as template
+// parameters and the number of threads and a context, e.g.
+//   ppartition( ppq::par.with_threads( 8 ), v.begin(), v.end(), pred );
+//   pquicksort( ppq::par.on( ctx ), v.begin(), v.end() );
+//   pquickselect( ppq::par.with_block_size< 4096 >(), v.begin(), nth, v.end() );
+// with PPQ_STD_EXECUTION defined the standard policies are accepted as
+// well: seq and unseq run the single-threaded routines, par the parallel
+// ones and par_unseq and unseq use simd_kernel
+// the standard policies are opt-in because <execution> links against TBB
+// with libstdc++ when TBB is installed
+namespace ppq
+{
+template< long BlockSize = 0, class Kernel = scanning_kernel >
+struct execution_policy
+{
+  using kernel = Kernel;
+
+  // 0 = the threads of the context or omp_get_max_threads()
+  int threads = 0;
+  // runs the call on the team of the context, threads is ignored then
+  context *ctx = nullptr;
+
+  constexpr execution_policy with_threads( const int num ) const { return { num, ctx }; }
+  constexpr execution_policy on( context &c ) const { return { threads, &c }; }
+  template< long B >
+  constexpr execution_policy< B, Kernel > with_block_size() const { return { threads, ctx }; }
+  template< class K >
+  constexpr execution_policy< BlockSize, K > with_kernel() const { return { threads, ctx }; }
+
+  int num_threads() const { return threads > 0 ? threads : omp_get_max_threads(); }
+};
+
+inline constexpr execution_policy<> par{};
+inline constexpr execution_policy< 0, simd_kernel > par_unseq{};
+
+// library policy and sequential flag of the standard policies
+template< class Policy >
+struct std_policy;
+
+#if defined( PPQ_STD_EXECUTION )
+template<>
+struct std_policy< std::execution::sequenced_policy >
+{
+  static constexpr bool sequential = true;
+  using type = execution_policy<>;
+};
+
+template<>
+struct std_policy< std::execution::parallel_policy >
+{
+  static constexpr bool sequential = false;
+  using type = execution_policy<>;
+};
+
+template<>
+struct std_policy< std::execution::parallel_unsequenced_policy >
+{
+  static constexpr bool sequential = false;
+  using type = execution_policy< 0, simd_kernel >;
+};
+
+#if defined( __cpp_lib_execution ) && __cpp_lib_execution >= 201902L
+template<>
+struct std_policy< std::execution::unsequenced_policy >
+{
+  static constexpr bool sequential = true;
+  using type = execution_policy< 0, simd_kernel >;
+};
+#endif
+#endif
+
+// checks whether Policy is one of the standard policies above
+template< class Policy, class = void >
+struct is_std_policy : std::false_type {};
+
+template< class Policy >
+struct is_std_policy< Policy, std::void_t< decltype( std_policy<Policy>::sequential ) > >
+  : std::true_type {};
+
+// sets the threads of the entry points without a num argument for the
+// calling thread, the previous number is restored at the end of the scope
+class num_threads_scope
+{
+public:
+  explicit num_threads_scope( const int num ) : previous( omp_get_max_threads() )
+  {
+    omp_set_num_threads( num );
+  }
+  ~num_threads_scope() { omp_set_num_threads( previous ); }
+private:
+  const int previous;
+};
+} // namespace ppq
+
+template< long BlockSize, class Kernel, class FwdIt, class Predicate >
+FwdIt ppartition( const ppq::execution_policy< BlockSize, Kernel > &policy,
+                  const FwdIt first, const FwdIt last, const Predicate pred )
+{
+  if( policy.ctx != nullptr )
+    return ppartition< BlockSize, Kernel >( *policy.ctx, first, last, pred );
+  return ppartition< BlockSize, Kernel >( first, last, pred, policy.num_threads() );
+}
+
+template< long BlockSize, class Kernel, class FwdIt, class Compare = std::less<> >
+void pquicksort( const ppq::execution_policy< BlockSize, Kernel > &policy,
+                 const FwdIt first, const FwdIt last, const Compare cmp = Compare{} )
+{
+  if( policy.ctx != nullptr )
+    return pquicksort< BlockSize, Kernel >( *policy.ctx, first, last, cmp );
+  const ppq::num_threads_scope threads( policy.num_threads() );
+  pquicksort< BlockSize, Kernel >( first, last, cmp );
+}
+
+template< long BlockSize, class Kernel, class FwdIt, class Compare = std::less<> >
+void pquickselect( const ppq::execution_policy< BlockSize, Kernel > &policy,
+                   const FwdIt first, const FwdIt nth, const FwdIt last,
+                   const Compare cmp = Compare{} )
+{
+  if( policy.ctx != nullptr )
+    return pquickselect< BlockSize, Kernel >( *policy.ctx, first, nth, last, cmp );
+  pquickselect< BlockSize, Kernel >( first, nth, last, cmp, policy.num_threads() );
+}
+
+// the standard policies
+template< class Policy, class FwdIt, class Predicate,
+          std::enable_if_t< ppq::is_std_policy< std::decay_t<Policy> >::value, int > = 0 >
+FwdIt ppartition( Policy &&, const FwdIt first, const FwdIt last, const Predicate pred )
+{
+  using Std = ppq::std_policy< std::decay_t<Policy> >;
+  using Library = typename Std::type;
+  if constexpr( Std::sequential )
+    return spartition< typename Library::kernel >( first, last, pred );
+  else
+    return ppartition( Library{}, first, last, pred );
+}
+
+template< class Policy, class FwdIt, class Compare = std::less<>,
+          std::enable_if_t< ppq::is_std_policy< std::decay_t<Policy> >::value, int > = 0 >
+void pquicksort( Policy &&, const FwdIt first, const FwdIt last, const Compare cmp = Compare{} )
+{
+  using Std = ppq::std_policy< std::decay_t<Policy> >;
+  using Library = typename Std::type;
+  if constexpr( Std::sequential )
+    quicksort< 0, typename Library::kernel >( first, last, cmp );
+  else
+    pquicksort( Library{}, first, last, cmp );
+}
+
+template< class Policy, class FwdIt, class Compare = std::less<>,
+          std::enable_if_t< ppq::is_std_policy< std::decay_t<Policy> >::value, int > = 0 >
+void pquickselect( Policy &&, const FwdIt first, const FwdIt nth, const FwdIt last,
+                   const Compare cmp = Compare{} )
+{
+  using Std = ppq::std_policy< std::decay_t<Policy> >;
+  using Library = typename Std::type;
+  if constexpr( Std::sequential )
+  {
+    if( first == last ) return;
+    const long rank = std::distance( first, nth );
+    quickselect_multi< 0, typename Library::kernel >( first, first, last, &rank,
+                                                      &rank + 1, cmp );
   }
+  else
+    pquickselect( Library{}, first, nth, last, cmp );
 }
 
 #endif // PPARTQUICK_HPP
@@ -0,0 +1,401 @@
+#include <omp.h>
+
+#include <vector>
+#include <algorithm>
+#include <parallel/algorithm>
+#include <functional>
+#include <random>
+#include <iterator>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <map>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+
+#include "ppartquick.hpp"
+
+// benchmark suite
+// every combination of algorithm, input distribution, element type, number
+// of threads and array size is run repetitions times on a fresh copy of
+// the input, one CSV line reports the median and the 95% confidence
+// interval of the median (order statistics, distribution-free)
+// the columns iterations, vectorsize, algorithm and time (sum of all
+// repetitions) are the ones of Paper/graphics/graphs/meassurement_*.csv,
+// graphs.py plots the file with: graphs.py benchmark.csv
+// with --baseline the medians are compared with an earlier CSV, a
+// combination whose confidence interval lies above the one of the
+// baseline and whose median is more than --tolerance slower is reported
+// as regression and the exit code is 1
+
+// elements of 64 bytes with an 8 byte key
+struct record64
+{
+  std::int64_t key;
+  char payload[56];
+  bool operator<( const record64 &other ) const { return key < other.key; }
+  bool operator==( const record64 &other ) const { return key == other.key; }
+};
+
+// converts a generated value into an element, the order of the values is kept
+template< class T > T make_element( const std::uint64_t value );
+
+template<> std::int32_t make_element( const std::uint64_t value )
+{
+  return static_cast<std::int32_t>( value & 0x7fffffff );
+}
+template<> std::int64_t make_element( const std::uint64_t value )
+{
+  return static_cast<std::int64_t>( value >> 1 );
+}
+template<> double make_element( const std::uint64_t value )
+{
+  return static_cast<double>( value >> 11 ) * 0x1.0p-53;
+}
+template<> std::string make_element( const std::uint64_t value )
+{
+  // fixed width, so the string order is the value order
+  char text[21];
+  std::snprintf( text, sizeof( text ), "%020llu", static_cast<unsigned long long>( value ) );
+  return text;
+}
+template<> record64 make_element( const std::uint64_t value )
+{
+  record64 r;
+  r.key = static_cast<std::int64_t>( value >> 1 );
+  std::memset( r.payload, static_cast<int>( value & 0xff ), sizeof( r.payload ) );
+  return r;
+}
+
+// input distributions
+const std::vector<std::string> all_distributions = {
+  "random", "sorted", "reverse", "equal", "few_uniques", "zipf", "organ_pipe",
+  "median3_killer" };
+
+// values of one distribution, the random ones are seeded by seed
+std::vector<std::uint64_t> generate_values( const std::string &distribution,
+                                            const long n, const unsigned seed )
+{
+  std::vector<std::uint64_t> v( n );
+  std::mt19937_64 gen( seed );
+  if( distribution == "random" )
+    for( auto &x : v ) x = gen();
+  else if( distribution == "sorted" )
+    for( long i = 0; i < n; ++i ) v[i] = i << 8;
+  else if( distribution == "reverse" )
+    for( long i = 0; i < n; ++i ) v[i] = ( n - i ) << 8;
+  else if( distribution == "equal" )
+    std::fill( v.begin(), v.end(), 42 << 8 );
+  else if( distribution == "few_uniques" )
+    for( auto &x : v ) x = ( gen() % 16 ) << 8;
+  else if( distribution == "zipf" )
+  {
+    // s = 1 over 2^20 values, inverse of the cumulative distribution
+    const long values = 1L << 20;
+    std::vector<double> cdf( values );
+    double sum = 0;
+    for( long k = 0; k < values; ++k ) cdf[k] = sum += 1.0 / ( k + 1 );
+    std::uniform_real_distribution<double> uniform( 0, sum );
+    for( auto &x : v )
+      x = ( std::lower_bound( cdf.begin(), cdf.end(), uniform( gen ) ) - cdf.begin() ) << 8;
+  }
+  else if( distribution == "organ_pipe" )
+    for( long i = 0; i < n; ++i ) v[i] = std::min( i, n - 1 - i ) << 8;
+  else if( distribution == "median3_killer" )
+  {
+    // Musser's median-of-3 killer sequence
+    const long k = n / 2;
+    for( long i = 1; i <= k; ++i )
+    {
+      v[i - 1] = ( ( i % 2 == 1 ) ? i : k + i - 1 ) << 8;
+      v[k + i - 1] = ( 2 * i ) << 8;
+    }
+    if( n % 2 == 1 ) v[n - 1] = ( 2 * k + 1 ) << 8;
+  }
+  else
+    throw std::invalid_argument( "unknown distribution " + distribution );
+  return v;
+}
+
+// algorithms, sorting ones end with the array sorted, ppartition,
+// ppartition3 and pquickselect are checked on their own
+const std::vector<std::string> all_algorithms = {
+  "std::sort", "__gnu_parallel::sort", "pquicksort", "pquicksort (branchless)",
+  "pquicksort (simd)", "pquicksort_dual_pivot", "psamplesort", "ppartition",
+  "ppartition3", "ppartition3 (two passes)", "pquickselect" };
+
+// runs algorithm on v, returns false if the result is wrong
+template< class T >
+bool run_algorithm( const std::string &algorithm, std::vector<T> &v,
+                    const std::vector<T> &sorted )
+{
+  const long n = v.size();
+  if( algorithm == "std::sort" ) std::sort( v.begin(), v.end() );
+  else if( algorithm == "__gnu_parallel::sort" ) __gnu_parallel::sort( v.begin(), v.end() );
+  else if( algorithm == "pquicksort" ) pquicksort( v.begin(), v.end() );
+  else if( algorithm == "pquicksort (branchless)" )
+    pquicksort< 0, branchless_kernel >( v.begin(), v.end() );
+  else if( algorithm == "pquicksort (simd)" ) pquicksort< 0, simd_kernel >( v.begin(), v.end() );
+  else if( algorithm == "pquicksort_dual_pivot" ) pquicksort_dual_pivot( v.begin(), v.end() );
+  else if( algorithm == "psamplesort" ) psamplesort( v.begin(), v.end() );
+  else if( algorithm == "ppartition" )
+  {
+    // an empty array has no pivot
+    if( n == 0 ) return ppartition( v.begin(), v.end(), []( const T & ) { return true; } ) == v.end();
+    const T pivot = sorted[n / 2];
+    auto pred = [&pivot]( const T &x ) { return x < pivot; };
+    const auto middle = ppartition( v.begin(), v.end(), pred );
+    return std::is_partitioned( v.begin(), v.end(), pred ) &&
+           middle - v.begin() == std::lower_bound( sorted.begin(), sorted.end(), pivot ) - sorted.begin();
+  }
+  else if( algorithm == "ppartition3" || algorithm == "ppartition3 (two passes)" )
+  {
+    if( n == 0 ) return true;
+    // pivots at a third and two thirds, both two-way partitionings one after
+    // the other are the former ppartition3
+    const dual_pivot_classifier< T, std::less<> > classify{ sorted[n / 3], sorted[2 * n / 3], {} };
+    auto middles = std::make_pair( v.begin(), v.begin() );
+    if( algorithm == "ppartition3" ) middles = ppartition3( v.begin(), v.end(), classify );
+    else
+    {
+#pragma omp parallel
+#pragma omp single
+      middles = partition3_passes< 0, scanning_kernel >( v.begin(), v.end(), classify,
+                                                         omp_get_num_threads() );
+    }
+    return std::is_partitioned( v.begin(), v.end(), classify.lower() ) &&
+           std::is_partitioned( middles.first, v.end(), classify.upper() ) &&
+           middles.first - v.begin() ==
+             std::lower_bound( sorted.begin(), sorted.end(), sorted[n / 3] ) - sorted.begin() &&
+           middles.second - v.begin() ==
+             std::upper_bound( sorted.begin(), sorted.end(), sorted[2 * n / 3] ) - sorted.begin();
+  }
+  else if( algorithm == "pquickselect" )
+  {
+    pquickselect( v.begin(), v.begin() + n / 2, v.end() );
+    return n == 0 || v[n / 2] == sorted[n / 2];
+  }
+  else
+    throw std::invalid_argument( "unknown algorithm " + algorithm );
+  return std::equal( v.begin(), v.end(), sorted.begin() );
+}
+
+// median and 95% confidence interval of the median
+struct summary
+{
+  double median, low, high, sum;
+};
+
+summary summarize( std::vector<double> times )
+{
+  std::sort( times.begin(), times.end() );
+  const long n = times.size();
+  summary s;
+  s.sum = 0;
+  for( const double t : times ) s.sum += t;
+  s.median = ( n % 2 == 1 ) ? times[n / 2] : 0.5 * ( times[n / 2 - 1] + times[n / 2] );
+  // ranks of the interval, normal approximation of the binomial distribution
+  const double half_width = 0.98 * std::sqrt( static_cast<double>( n ) );
+  const long low = std::max( 0L, static_cast<long>( std::floor( n / 2.0 - half_width ) ) );
+  const long high = std::min( n - 1, static_cast<long>( std::ceil( n / 2.0 + half_width ) ) );
+  s.low = times[low];
+  s.high = times[high];
+  return s;
+}
+
+// splits a comma-separated list
+std::vector<std::string> split( const std::string &list )
+{
+  std::vector<std::string> items;
+  std::istringstream stream( list );
+  for( std::string item; std::getline( stream, item, ',' ); )
+    if( !item.empty() ) items.push_back( item );
+  return items;
+}
+
+std::vector<long> split_numbers( const std::string &list )
+{
+  std::vector<long> numbers;
+  for( const auto &item : split( list ) ) numbers.push_back( std::stol( item ) );
+  return numbers;
+}
+
+struct options
+{
+  std::vector<std::string> algorithms = all_algorithms;
+  std::vector<std::string> distributions = all_distributions;
+  std::vector<std::string> types = { "int32", "int64", "double", "string", "record64" };
+  std::vector<long> threads = { omp_get_max_threads() };
+  std::vector<long> sizes = { 1000000 };
+  int repetitions = 15;
+  std::string output;
+  std::string baseline;
+  double tolerance = 0.05;
+};
+
+// key of a CSV line without the measured values
+std::string csv_key( const std::string &algorithm, const std::string &distribution,
+                     const std::string &type, const long threads, const long size )
+{
+  std::ostringstream key;
+  key << algorithm << ';' << distribution << ';' << type << ';' << threads << ';' << size;
+  return key.str();
+}
+
+// runs all combinations of one element type, returns false on a wrong result
+template< class T >
+bool benchmark_type( const std::string &type, const options &opt, std::ostream &csv,
+                     std::map< std::string, summary > &results )
+{
+  bool correct = true;
+  for( const long size : opt.sizes )
+    for( const auto &distribution : opt.distributions )
+    {
+      const auto values = generate_values( distribution, size, 12345 );
+      std::vector<T> input( size );
+      for( long i = 0; i < size; ++i ) input[i] = make_element<T>( values[i] );
+      std::vector<T> sorted( input );
+      std::sort( sorted.begin(), sorted.end() );
+
+      for( const long threads : opt.threads )
+      {
+        omp_set_num_threads( threads );
+        for( const auto &algorithm : opt.algorithms )
+        {
+          std::vector<double> times;
+          for( int r = 0; r < opt.repetitions; ++r )
+          {
+            std::vector<T> v( input );
+            const auto t0 = std::chrono::steady_clock::now();
+            const bool ok = run_algorithm( algorithm, v, sorted );
+            const auto t1 = std::chrono::steady_clock::now();
+            times.push_back( std::chrono::duration<double>( t1 - t0 ).count() );
+            if( !ok )
+            {
+              std::cerr << "FAILED: " << algorithm << ", " << distribution << ", " << type
+                        << ", " << threads << " threads, " << size << " elements\n";
+              correct = false;
+              break;
+            }
+          }
+          const summary s = summarize( times );
+          results[csv_key( algorithm, distribution, type, threads, size )] = s;
+          csv << opt.repetitions << ',' << size << ',' << algorithm << ',' << s.sum << ','
+              << distribution << ',' << type << ',' << threads << ',' << s.median << ','
+              << s.low << ',' << s.high << '\n' << std::flush;
+        }
+      }
+    }
+  return correct;
+}
+
+// reads the summaries of an earlier run
+std::map< std::string, summary > read_csv( const std::string &path )
+{
+  std::map< std::string, summary > results;
+  std::ifstream file( path );
+  if( !file ) throw std::runtime_error( "cannot open " + path );
+  std::string line;
+  std::getline( file, line );
+  while( std::getline( file, line ) )
+  {
+    const auto f = split( line );
+    if( f.size() < 10 ) continue;
+    summary s;
+    s.sum = std::stod( f[3] );
+    s.median = std::stod( f[7] );
+    s.low = std::stod( f[8] );
+    s.high = std::stod( f[9] );
+    results[csv_key( f[2], f[4], f[5], std::stol( f[6] ), std::stol( f[1] ) )] = s;
+  }
+  return results;
+}
+
+int main( int argc, char* argv[] )
+{
+  options opt;
+  for( int i = 1; i < argc; ++i )
+  {
+    const std::string arg = argv[i];
+    const std::string value = ( i + 1 < argc ) ? argv[i + 1] : "";
+    if( arg == "--algorithms" ) opt.algorithms = split( value );
+    else if( arg == "--distributions" ) opt.distributions = split( value );
+    else if( arg == "--types" ) opt.types = split( value );
+    else if( arg == "--threads" ) opt.threads = split_numbers( value );
+    else if( arg == "--sizes" ) opt.sizes = split_numbers( value );
+    else if( arg == "--repetitions" ) opt.repetitions = std::stoi( value );
+    else if( arg == "--output" ) opt.output = value;
+    else if( arg == "--baseline" ) opt.baseline = value;
+    else if( arg == "--tolerance" ) opt.tolerance = std::stod( value );
+    else
+    {
+      std::cerr << "usage: " << argv[0] << " [options]\n"
+                << "  --algorithms a,b,...     default: all\n"
+                << "  --distributions a,b,...  random, sorted, reverse, equal, few_uniques,\n"
+                << "                           zipf, organ_pipe, median3_killer (default: all)\n"
+                << "  --types a,b,...          int32, int64, double, string, record64\n"
+                << "  --threads 1,2,4,...      default: omp_get_max_threads()\n"
+                << "  --sizes n1,n2,...        default: 1000000\n"
+                << "  --repetitions r          default: 15\n"
+                << "  --output file.csv        default: standard output\n"
+                << "  --baseline file.csv      compares the medians with an earlier run\n"
+                << "  --tolerance t            slowdown reported as regression, default: 0.05\n"
+                << "algorithms:";
+      for( const auto &algorithm : all_algorithms ) std::cerr << " \"" << algorithm << "\"";
+      std::cerr << std::endl;
+      return -1;
+    }
+    ++i;
+  }
+  // summarize needs at least one time
+  if( opt.repetitions < 1 )
+  {
+    std::cerr << "--repetitions has to be at least 1" << std::endl;
+    return -1;
+  }
+
+  std::ofstream file;
+  if( !opt.output.empty() ) file.open( opt.output );
+  std::ostream &csv = opt.output.empty() ? std::cout : file;
+  csv << "iterations,vectorsize,algorithm,time,distribution,type,threads,median,ci_low,ci_high\n";
+
+  std::map< std::string, summary > results;
+  bool correct = true;
+  for( const auto &type : opt.types )
+  {
+    if( type == "int32" ) correct &= benchmark_type< std::int32_t >( type, opt, csv, results );
+    else if( type == "int64" ) correct &= benchmark_type< std::int64_t >( type, opt, csv, results );
+    else if( type == "double" ) correct &= benchmark_type< double >( type, opt, csv, results );
+    else if( type == "string" ) correct &= benchmark_type< std::string >( type, opt, csv, results );
+    else if( type == "record64" ) correct &= benchmark_type< record64 >( type, opt, csv, results );
+    else
+    {
+      std::cerr << "unknown type " << type << std::endl;
+      return -1;
+    }
+  }
+  if( !correct ) return 1;
+  if( opt.baseline.empty() ) return 0;
+
+  // regression: the intervals do not overlap and the median is slower than
+  // the tolerance allows
+  int regressions = 0;
+  for( const auto &entry : read_csv( opt.baseline ) )
+  {
+    const auto it = results.find( entry.first );
+    if( it == results.end() ) continue;
+    const summary &before = entry.second;
+    const summary &now = it->second;
+    if( now.low > before.high && now.median > before.median * ( 1 + opt.tolerance ) )
+    {
+      std::cerr << "REGRESSION: " << entry.first << ": " << before.median << " s -> "
+                << now.median << " s\n";
+      ++regressions;
+    }
+  }
+  std::cerr << regressions << " regressions" << std::endl;
+  return regressions > 0 ? 1 : 0;
+}
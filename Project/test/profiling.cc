@@ -1,12 +1,39 @@
+// hardware counters of the algorithms and of the phases of the parallel
+// partitioning, read with perf_event_open ( Linux, g++ or clang++ )
+// - cycles, instructions, branch misses, L1d read misses and LLC misses are
+//   counted per thread for all threads of the process
+// - the memory bandwidth is read from the memory controllers ( uncore_imc )
+//   if the kernel allows system-wide counters ( perf_event_paranoid <= 0 or
+//   CAP_PERFMON ), else it is estimated as LLC misses * 64 bytes
+// - the phases are taken from the ppq::stats hooks ( PPQ_STATS ), the time
+//   outside of the phases ( pivot selection, sequential sorts, ... ) is
+//   reported as "other"
 #include <vector>
 #include <algorithm>
 #include <functional>
 #include <random>
 #include <iterator>
 #include <iostream>
+#include <iomanip>
 #include <chrono>
 #include <sstream>
+#include <fstream>
+#include <string>
+#include <mutex>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdint>
 
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#ifndef PPQ_STATS
+#define PPQ_STATS
+#endif
 #include "ppartquick.hpp"
 
 template <typename Iter>
@@ -30,13 +57,369 @@ void generateRandomIntVector( Iter first, Iter last )
   }
 }
 
+// counted events, the values are summed over all threads
+enum event { cycles, instructions, branch_misses, l1d_misses, llc_misses, memory_bytes,
+             events };
+
+struct counter_values
+{
+  double v[events] = {};
+
+  counter_values &operator+=( const counter_values &other )
+  {
+    for( int e = 0; e < events; ++e ) v[e] += other.v[e];
+    return *this;
+  }
+  counter_values operator-( const counter_values &other ) const
+  {
+    counter_values result = *this;
+    for( int e = 0; e < events; ++e ) result.v[e] -= other.v[e];
+    return result;
+  }
+};
+
+inline int perf_event_open( perf_event_attr &attr, const pid_t pid, const int cpu )
+{
+  return syscall( SYS_perf_event_open, &attr, pid, cpu, -1, 0 );
+}
+
+// value of a counter opened with read_format enabled and running, scaled up
+// if the kernel multiplexed the counter
+inline double read_scaled( const int fd )
+{
+  uint64_t data[3];
+  if( read( fd, data, sizeof( data ) ) != sizeof( data ) || data[2] == 0 ) return 0;
+  return static_cast<double>( data[0] ) * data[1] / data[2];
+}
+
+inline std::string read_line( const std::string &path )
+{
+  std::ifstream in( path );
+  std::string line;
+  std::getline( in, line );
+  return line;
+}
+
+// per-thread counters of all threads in /proc/self/task
+class thread_counters
+{
+public:
+  ~thread_counters()
+  {
+    for( const auto &t : threads )
+      for( const int fd : t.fd ) if( fd >= 0 ) close( fd );
+  }
+
+  // opens the counters of threads which were started since the last call
+  void attach()
+  {
+    DIR *dir = opendir( "/proc/self/task" );
+    if( dir == nullptr ) return;
+    while( const dirent *entry = readdir( dir ) )
+    {
+      const pid_t tid = std::atoi( entry->d_name );
+      if( tid <= 0 || std::any_of( threads.begin(), threads.end(),
+                                   [tid]( const thread &t ) { return t.tid == tid; } ) )
+        continue;
+      thread t{ tid, {} };
+      for( int e = 0; e < memory_bytes; ++e )
+      {
+        perf_event_attr attr = attributes( static_cast<event>( e ) );
+        t.fd[e] = perf_event_open( attr, tid, -1 );
+        if( t.fd[e] < 0 && error.empty() )
+          error = std::string( "perf_event_open: " ) + std::strerror( errno );
+      }
+      threads.push_back( t );
+    }
+    closedir( dir );
+  }
+
+  counter_values read() const
+  {
+    counter_values values;
+    for( const auto &t : threads )
+      for( int e = 0; e < memory_bytes; ++e )
+        if( t.fd[e] >= 0 ) values.v[e] += read_scaled( t.fd[e] );
+    return values;
+  }
+
+  // first failure, e.g. no PMU in a virtual machine or perf_event_paranoid > 2
+  std::string error;
+
+private:
+  struct thread
+  {
+    pid_t tid;
+    int fd[memory_bytes];
+  };
+
+  static perf_event_attr attributes( const event e )
+  {
+    perf_event_attr attr;
+    std::memset( &attr, 0, sizeof( attr ) );
+    attr.size = sizeof( attr );
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // user space only, allowed up to perf_event_paranoid = 2
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    switch( e )
+    {
+      case cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+      case instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+      case branch_misses: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+      case l1d_misses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_L1D | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) |
+                      ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 );
+        break;
+      // the generic cache misses are the last-level cache misses
+      default: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+    }
+    return attr;
+  }
+
+  std::vector<thread> threads;
+};
+
+// bytes read and written by the memory controllers, system-wide
+class memory_counters
+{
+public:
+  memory_counters()
+  {
+    DIR *dir = opendir( "/sys/bus/event_source/devices" );
+    if( dir == nullptr ) return;
+    while( const dirent *entry = readdir( dir ) )
+      if( std::strncmp( entry->d_name, "uncore_imc", 10 ) == 0 )
+        open_device( std::string( "/sys/bus/event_source/devices/" ) + entry->d_name );
+    closedir( dir );
+  }
+  ~memory_counters() { for( const auto &c : counters ) close( c.fd ); }
+
+  bool available() const { return !counters.empty(); }
+
+  double bytes() const
+  {
+    double sum = 0;
+    for( const auto &c : counters ) sum += read_scaled( c.fd ) * c.scale;
+    return sum;
+  }
+
+private:
+  struct counter
+  {
+    int fd;
+    double scale;
+  };
+
+  // "config:8-15" -> shift 8, width 8
+  static bool format_field( const std::string &device, const std::string &name,
+                            int &shift, int &width )
+  {
+    const std::string format = read_line( device + "/format/" + name );
+    int low, high;
+    if( std::sscanf( format.c_str(), "config:%d-%d", &low, &high ) == 2 )
+    {
+      shift = low;
+      width = high - low + 1;
+      return true;
+    }
+    if( std::sscanf( format.c_str(), "config:%d", &low ) == 1 )
+    {
+      shift = low;
+      width = 1;
+      return true;
+    }
+    return false;
+  }
+
+  // "event=0x04,umask=0x03" with the bit fields of the format directory
+  static bool event_config( const std::string &device, const std::string &name,
+                            uint64_t &config )
+  {
+    std::istringstream terms( read_line( device + "/events/" + name ) );
+    std::string term;
+    config = 0;
+    bool any = false;
+    while( std::getline( terms, term, ',' ) )
+    {
+      const auto equal = term.find( '=' );
+      const std::string field = term.substr( 0, equal );
+      const uint64_t value = equal == std::string::npos ? 1 :
+                             std::strtoull( term.c_str() + equal + 1, nullptr, 0 );
+      int shift, width;
+      if( !format_field( device, field, shift, width ) ) return false;
+      const uint64_t mask = width >= 64 ? ~uint64_t( 0 ) : ( uint64_t( 1 ) << width ) - 1;
+      config |= ( value & mask ) << shift;
+      any = true;
+    }
+    return any;
+  }
+
+  void open_device( const std::string &device )
+  {
+    const int type = std::atoi( read_line( device + "/type" ).c_str() );
+    // one cpu per socket
+    std::vector<int> cpus;
+    std::istringstream mask( read_line( device + "/cpumask" ) );
+    std::string cpu;
+    while( std::getline( mask, cpu, ',' ) ) cpus.push_back( std::atoi( cpu.c_str() ) );
+    if( cpus.empty() ) cpus.push_back( 0 );
+
+    for( const char *name : { "cas_count_read", "cas_count_write" } )
+    {
+      perf_event_attr attr;
+      std::memset( &attr, 0, sizeof( attr ) );
+      attr.size = sizeof( attr );
+      attr.type = type;
+      attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      uint64_t config;
+      if( !event_config( device, name, config ) ) continue;
+      attr.config = config;
+      // the scale converts counts to the unit, usually MiB
+      double scale = 64;
+      const std::string scale_text = read_line( device + "/events/" + name + ".scale" );
+      if( !scale_text.empty() )
+      {
+        scale = std::atof( scale_text.c_str() );
+        if( read_line( device + "/events/" + name + ".unit" ) == "MiB" ) scale *= 1 << 20;
+      }
+      for( const int c : cpus )
+      {
+        const int fd = perf_event_open( attr, -1, c );
+        if( fd >= 0 ) counters.push_back( { fd, scale } );
+      }
+    }
+  }
+
+  std::vector<counter> counters;
+};
+
+class profiler
+{
+public:
+  profiler()
+  {
+    // starts the threads of the OpenMP team, so that their counters exist
+#pragma omp parallel
+    {
+    }
+    threads.attach();
+  }
+
+  // runs f and prints the counters per phase
+  template< class F >
+  void run( const F &f )
+  {
+    threads.attach();
+    ppq::stats stats;
+    stats.phase_hook = &profiler::on_phase;
+    stats.phase_data = this;
+    for( auto &values : phases ) values = counter_values{};
+
+    const auto t0 = std::chrono::steady_clock::now();
+    previous = read();
+    {
+      ppq::stats_scope collect( stats );
+      f();
+    }
+    on_phase( this, ppq::stats_phases );
+    const auto t1 = std::chrono::steady_clock::now();
+
+    double seconds[ppq::stats_phases + 1];
+    seconds[ppq::stats_phases] = std::chrono::duration<double>( t1 - t0 ).count();
+    for( int phase = 0; phase < ppq::stats_phases; ++phase )
+    {
+      seconds[phase] = stats.seconds( static_cast<ppq::stats_phase>( phase ) );
+      seconds[ppq::stats_phases] -= seconds[phase];
+    }
+    // concurrent phases overlap
+    seconds[ppq::stats_phases] = std::max( 0.0, seconds[ppq::stats_phases] );
+    counter_values total;
+    for( const auto &values : phases ) total += values;
+    for( int phase = 0; phase <= ppq::stats_phases; ++phase )
+    {
+      time[phase] += seconds[phase];
+      sum[phase] += phases[phase];
+    }
+    time[ppq::stats_phases + 1] += std::chrono::duration<double>( t1 - t0 ).count();
+    sum[ppq::stats_phases + 1] += total;
+  }
+
+  // prints the sums of all runs since the last print
+  void print()
+  {
+    static const char *const names[ppq::stats_phases + 2] = {
+      "parallel_phase", "neutralization", "swapping", "final_partition", "other", "total" };
+    if( !threads.error.empty() )
+      std::cout << " " << threads.error << " ( counters are zero )\n";
+    std::cout << std::setw( 16 ) << "phase" << std::setw( 11 ) << "time [s]"
+              << std::setw( 15 ) << "cycles" << std::setw( 15 ) << "instructions"
+              << std::setw( 6 ) << "IPC" << std::setw( 14 ) << "branch-misses"
+              << std::setw( 13 ) << "L1d-misses" << std::setw( 13 ) << "LLC-misses"
+              << std::setw( 10 ) << ( memory.available() ? "GB/s" : "~GB/s" ) << "\n";
+    for( int phase = 0; phase < ppq::stats_phases + 2; ++phase )
+    {
+      const counter_values &c = sum[phase];
+      const double bytes = memory.available() ? c.v[memory_bytes] : c.v[llc_misses] * 64;
+      std::cout << std::setw( 16 ) << names[phase]
+                << std::setw( 11 ) << std::fixed << std::setprecision( 4 ) << time[phase]
+                << std::setw( 15 ) << std::setprecision( 0 ) << c.v[cycles]
+                << std::setw( 15 ) << c.v[instructions]
+                << std::setw( 6 ) << std::setprecision( 2 )
+                << ( c.v[cycles] > 0 ? c.v[instructions] / c.v[cycles] : 0 )
+                << std::setw( 14 ) << std::setprecision( 0 ) << c.v[branch_misses]
+                << std::setw( 13 ) << c.v[l1d_misses]
+                << std::setw( 13 ) << c.v[llc_misses]
+                << std::setw( 10 ) << std::setprecision( 2 )
+                << ( time[phase] > 0 ? bytes / time[phase] / 1e9 : 0 ) << "\n";
+      std::cout.unsetf( std::ios::fixed );
+    }
+    std::cout << std::setprecision( 6 ) << "\n";
+    for( int phase = 0; phase < ppq::stats_phases + 2; ++phase )
+    {
+      time[phase] = 0;
+      sum[phase] = counter_values{};
+    }
+  }
+
+private:
+  counter_values read() const
+  {
+    counter_values values = threads.read();
+    if( memory.available() ) values.v[memory_bytes] = memory.bytes();
+    return values;
+  }
+
+  // the counts since the last boundary belong to the phase which just ended,
+  // phases of concurrent partitionings are attributed to the first to end
+  static void on_phase( void *data, const int phase )
+  {
+    profiler &self = *static_cast<profiler *>( data );
+    std::lock_guard<std::mutex> lock( self.mutex );
+    const counter_values now = self.read();
+    self.phases[phase] += now - self.previous;
+    self.previous = now;
+  }
+
+  thread_counters threads;
+  memory_counters memory;
+  std::mutex mutex;
+  counter_values previous;
+  counter_values phases[ppq::stats_phases + 1];
+  // sums of all runs, the last entry is the total
+  double time[ppq::stats_phases + 2] = {};
+  counter_values sum[ppq::stats_phases + 2];
+};
+
 int main(int argc, char* argv[])
 {
   if(4 != argc)
   {
     std::cerr << "usage: " << argv[0] << " <mode> <iterations> <arraysize> \n"
               << "  mode:\n  1: Partitioning\n  2: Quicksort\n"
-              << "  3: Quickselect\n  4: Quicksort (dual pivot)" << std::endl;
+              << "  3: Quickselect\n  4: Quicksort (dual pivot)\n  5: 1 & 2 & 3 & 4" << std::endl;
     return -1;
   }
   int MODE, RUNS, SIZE;
@@ -49,115 +432,68 @@ int main(int argc, char* argv[])
     return -1;
   }
 
-  auto clock = std::chrono::high_resolution_clock();
-  auto t0 = clock.now();
-  auto t1 = clock.now();
-  auto time1 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
-  auto time2 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
-
-  int THREADS = omp_get_max_threads();
-  int work_share = SIZE / THREADS;
+  profiler prof;
 
 // TEST ppartition /////////////////////////////////////////////////////////////
 
-  if( 1 == MODE )
+  if( 1 == MODE || 5 == MODE )
   {
     std::cout << "\nTEST: ppartition ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
-    time1 = 0; time2 = 0;
 
     for( int i = 0; i < RUNS; ++i )
     {
-      t0 = clock.now();
       std::vector<int> g( SIZE );
       generateRandomIntVector( g.begin(), g.end() );
-      t1 = clock.now();
-      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
-
-      t0 = clock.now();
-      auto g_it = ppartition( g.begin(), g.end(), []( int i ){ return i%2 == 0; } );
-      t1 = clock.now();
-      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      prof.run( [&]() { ppartition( g.begin(), g.end(), []( int i ){ return i%2 == 0; } ); } );
     }
-    std::cout << "               ppartition: " << time2 << " s\n";
-    std::cout << "                 overhead: " << time1 << " s\n\n";
+    prof.print();
   }
 
 // TEST pquicksort /////////////////////////////////////////////////////////////
 
-  if( 2 == MODE )
+  if( 2 == MODE || 5 == MODE )
   {
     std::cout << "\nTEST: pquicksort ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
-    time1 = 0; time2 = 0;
 
     for( int i = 0; i < RUNS; i++ )
     {
-      t0 = clock.now();
       std::vector<int> s( SIZE );
       generateRandomIntVector( s.begin(), s.end() );
-      t1 = clock.now();
-      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
-
-      t0 = clock.now();
-      pquicksort( s.begin(), s.end() );
-      t1 = clock.now();
-      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      prof.run( [&]() { pquicksort( s.begin(), s.end() ); } );
     }
-
-    std::cout << "          pquicksort: " << time2 << " s\n";
-    std::cout << "            overhead: " << time1 << " s\n\n";
+    prof.print();
   }
 
 // TEST pquickselect ///////////////////////////////////////////////////////////
 
-  if ( 3 == MODE )
+  if ( 3 == MODE || 5 == MODE )
   {
     std::cout << "\nTEST: pquickselect ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
-    time1 = 0;
 
     for( int i = 0; i < RUNS; i++ )
     {
-      t0 = clock.now();
       std::vector<int> t( SIZE );
       generateRandomIntVector( t.begin(), t.end() );
-      t1 = clock.now();
-      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
-
-      int k = i;
-
-      t0 = clock.now();
-      pquickselect( t.begin(), t.begin() + k, t.end() );
-      t1 = clock.now();
-      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      int k = i % SIZE;
+      prof.run( [&]() { pquickselect( t.begin(), t.begin() + k, t.end() ); } );
     }
-
-    std::cout << "               pquickselect: " << time2 << " s\n";
-    std::cout << "                   overhead: " << time1 << " s\n\n";
+    prof.print();
   }
 
 // TEST pquicksort_dual_pivot /////////////////////////////////////////////////////////////
 
-  if( 4 == MODE )
+  if( 4 == MODE || 5 == MODE )
   {
     std::cout << "\nTEST: pquicksort_dual_pivot ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
-    time1 = 0; time2 = 0;
 
     for( int i = 0; i < RUNS; i++ )
     {
-      t0 = clock.now();
       std::vector<int> d( SIZE );
       generateRandomIntVector( d.begin(), d.end() );
-      t1 = clock.now();
-      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
-
-      t0 = clock.now();
-      pquicksort( d.begin(), d.end() );
-      t1 = clock.now();
-      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      prof.run( [&]() { pquicksort_dual_pivot( d.begin(), d.end() ); } );
     }
-
-    std::cout << "pquicksort_dual_pivot: " << time2 << " s\n";
-    std::cout << "             overhead: " << time1 << " s\n\n";
+    prof.print();
   }
 
-  return 1;
+  return 0;
 }
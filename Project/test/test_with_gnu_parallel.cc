@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <numeric>
 #include <parallel/algorithm>
 #include <functional>
 #include <random>
@@ -9,6 +10,14 @@
 #include <iostream>
 #include <chrono>
 #include <sstream>
+#include <string>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+#include <thread>
 
 #include "ppartquick.hpp"
 
@@ -40,6 +49,142 @@ void generateRandomIntVector( Iter first, Iter last )
   }
 }
 
+// adversarial inputs of mode 9
+// 0: sorted, 1: reverse sorted, 2: organ pipe, 3: all equal, 4: four distinct
+// values, 5: sawtooth, 6: median-of-three killer (Musser)
+const int ADVERSARIAL_INPUTS = 7;
+const char *adversarialName( int input )
+{
+  const char *names[] = { "sorted", "reverse sorted", "organ pipe", "all equal",
+                          "four distinct", "sawtooth", "median-of-3 killer" };
+  return names[input];
+}
+
+template <typename Iter>
+void generateAdversarialVector( Iter first, Iter last, int input )
+{
+  long SIZE = last - first;
+  long k = SIZE / 2;
+  for( long i = 0; i < SIZE; ++i )
+  {
+    switch( input )
+    {
+      case 0: first[i] = i; break;
+      case 1: first[i] = SIZE - i; break;
+      case 2: first[i] = i < k ? i : SIZE - i; break;
+      case 3: first[i] = 42; break;
+      case 4: first[i] = i % 4; break;
+      case 5: first[i] = i % 1000; break;
+      default: first[i] = i; break;
+    }
+  }
+  if( 6 == input )
+  {
+    for( long i = 1; i <= k; ++i )
+    {
+      if( i % 2 == 1 )
+      {
+        first[i-1] = i;
+        first[i] = k + i;
+      }
+      first[k+i-1] = 2 * i;
+    }
+  }
+}
+
+const int PRESORTED_INPUTS = 5;
+
+const char *presortedName( int input )
+{
+  const char *names[] = { "random", "sorted", "reverse sorted",
+                          "8 sorted runs", "sorted, 0.01% swapped" };
+  return names[input];
+}
+
+template <typename Iter>
+void generatePresortedVector( Iter first, Iter last, int input )
+{
+  long SIZE = last - first;
+  std::random_device rd;
+  std::mt19937 gen( rd() );
+  for( long i = 0; i < SIZE; ++i ) first[i] = gen();
+  switch( input )
+  {
+    case 1: std::sort( first, last ); break;
+    case 2: std::sort( first, last, std::greater<>() ); break;
+    case 3:
+      for( int j = 0; j < 8; ++j )
+        std::sort( first + SIZE * j / 8, first + SIZE * (j + 1) / 8 );
+      break;
+    case 4:
+      std::sort( first, last );
+      for( long i = 0; i < SIZE / 10000; ++i )
+        std::swap( first[gen() % SIZE], first[gen() % SIZE] );
+      break;
+    default: break;
+  }
+}
+
+// counts the comparisons to check the O(n log n) bound
+struct CountingLess
+{
+  std::atomic<long> *comparisons;
+  bool operator()( int a, int b ) const
+  {
+    comparisons->fetch_add( 1, std::memory_order_relaxed );
+    return a < b;
+  }
+};
+
+// McIlroy's adversary ("A Killer Adversary for Quicksort"): the values of
+// the elements are fixed lazily, so that every pivot becomes one of the
+// smallest remaining elements, only consistent single-threaded
+struct Antiqsort
+{
+  std::vector<int> *val;
+  int *nsolid;
+  int *candidate;
+  long *comparisons;
+  bool operator()( int x, int y ) const
+  {
+    const int gas = val->size();
+    ++*comparisons;
+    if( (*val)[x] == gas && (*val)[y] == gas )
+      (*val)[ x == *candidate ? x : y ] = (*nsolid)++;
+    if( (*val)[x] == gas ) *candidate = x;
+    else if( (*val)[y] == gas ) *candidate = y;
+    return (*val)[x] < (*val)[y];
+  }
+};
+
+// counts the heap allocations of the strings of mode 17, every copy of a
+// string longer than the small string buffer allocates, a move does not
+std::atomic<long> stringAllocations( 0 );
+
+template< class T >
+struct CountingAllocator
+{
+  using value_type = T;
+  CountingAllocator() = default;
+  template< class U > CountingAllocator( const CountingAllocator<U> & ) {}
+  T *allocate( std::size_t n )
+  {
+    stringAllocations.fetch_add( 1, std::memory_order_relaxed );
+    return std::allocator<T>().allocate( n );
+  }
+  void deallocate( T *p, std::size_t n ) { std::allocator<T>().deallocate( p, n ); }
+  bool operator==( const CountingAllocator & ) const { return true; }
+  bool operator!=( const CountingAllocator & ) const { return false; }
+};
+using CountedString = std::basic_string< char, std::char_traits<char>, CountingAllocator<char> >;
+
+// record of mode 18, a key and Bytes - 8 bytes of payload
+template< int Bytes >
+struct Record
+{
+  long key;
+  char payload[Bytes - sizeof(long)];
+};
 
 int main( int argc, char* argv[] )
 {
@@ -48,7 +193,15 @@ int main( int argc, char* argv[] )
     std::cerr << "usage: " << argv[0] << " <mode> <iterations> <arraysize> \n"
               << "  mode:\n  1: Partitioning\n  2: Quicksort\n"
               << "  3: Quickselect\n  4: 1 & 2\n  5: 1 & 3\n  6: 2 & 3\n"
-              << "  7: 1 & 2 & 3" << std::endl;
+              << "  7: 1 & 2 & 3\n  8: Radix sort\n  9: Adversarial inputs\n"
+              << "  10: Presorted inputs\n  11: Small arrays ( latency per call )\n"
+              << "  12: NUMA ( first-touch initialized arrays )\n"
+              << "  13: Out-of-core file sort\n  14: Key-value sort and argsort\n"
+              << "  15: Execution policies\n"
+              << "  16: Statistics ( compile with -DPPQ_STATS )\n"
+              << "  17: String sort ( time and allocations )\n"
+              << "  18: Large records ( direct and indirect sort )\n"
+              << "  19: Strings with shared prefixes ( pstring_sort )" << std::endl;
     return -1;
   }
   int MODE, RUNS;
@@ -68,12 +221,17 @@ int main( int argc, char* argv[] )
   auto time0 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
   auto time1 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
   auto time2 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+  auto time3 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+  auto time4 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+  auto time5 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+  auto time6 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+  auto time7 = std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
 
 // TEST ppartition /////////////////////////////////////////////////////////////
   if ( 1 == MODE || 4 == MODE || 5 == MODE || 7 == MODE )
   {
     std::cout << "\nTEST: ppartition ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
-    time0 = 0; time1 = 0; time2 = 0;
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0; time4 = 0; time5 = 0; time6 = 0; time7 = 0;
 
     for( int i = 0; i < RUNS; ++i )
     {
@@ -81,6 +239,9 @@ int main( int argc, char* argv[] )
       generateRandomIntVector( g.begin(), g.end() );
       std::vector<int> g2( g );
       std::vector<int> g3( g );
+      std::vector<int> g4( g );
+      std::vector<int> g5( g );
+      std::vector<int> g6( g );
 
       if( !std::equal( g.begin(), g.end(), g2.begin() ) )
         std::cout << "WARRNING: no equal arrays at the beginning\n";
@@ -100,12 +261,87 @@ int main( int argc, char* argv[] )
       t1 = clock.now();
       time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
 
+      t0 = clock.now();
+      auto g4_it = ppartition< 0, branchless_kernel >( g4.begin(), g4.end(), [](int i){return i%2 == 0;} );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      auto g5_it = pstable_partition( g5.begin(), g5.end(), [](int i){return i%2 == 0;} );
+      t1 = clock.now();
+      time4 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      // pstable_partition has to keep the order of std::stable_partition
+      auto g6_it = std::stable_partition( g6.begin(), g6.end(), [](int i){return i%2 == 0;} );
+      if( !std::equal( g5.begin(), g5.end(), g6.begin() ) ||
+          ( g5_it - g5.begin() ) != ( g6_it - g6.begin() ) )
+      {
+        std::cout << " FAILED ( turn: " << i << ", pstable_partition )\n";
+        break;
+      }
+
+      // stability with duplicate keys: ( key, input position ) pairs with
+      // 16 keys, the predicate only reads the key
+      std::vector< std::pair<int, long> > k1( SIZE );
+      for( long k = 0; k < SIZE; ++k ) k1[k] = { ( g6[k] & 0xffff ) % 16, k };
+      std::vector< std::pair<int, long> > k2( k1 ), k3( k1 );
+      auto key_pred = []( const std::pair<int, long> &x ) { return x.first % 3 == 0; };
+
+      auto k1_it = pstable_partition( k1.begin(), k1.end(), key_pred );
+      t0 = clock.now();
+      auto k2_it = pstable_partition_inplace( k2.begin(), k2.end(), key_pred );
+      t1 = clock.now();
+      time5 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      auto k3_it = std::stable_partition( k3.begin(), k3.end(), key_pred );
+      if( k1 != k3 || k2 != k3 ||
+          ( k1_it - k1.begin() ) != ( k3_it - k3.begin() ) ||
+          ( k2_it - k2.begin() ) != ( k3_it - k3.begin() ) )
+      {
+        std::cout << " FAILED ( turn: " << i << ", pstable_partition with duplicate keys )\n";
+        break;
+      }
+
+      // ppartition3 in one pass and both two-way partitionings one after the
+      // other, two pivots taken from the array
+      const dual_pivot_classifier< int, std::less<> > classify{
+        std::min( g6[SIZE / 3], g6[2 * SIZE / 3] ), std::max( g6[SIZE / 3], g6[2 * SIZE / 3] ), {} };
+      std::vector<int> g7( g6 ), g8( g6 );
+      t0 = clock.now();
+      const auto g7_its = ppartition3( g7.begin(), g7.end(), classify );
+      t1 = clock.now();
+      time6 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      auto g8_its = std::make_pair( g8.begin(), g8.begin() );
+      t0 = clock.now();
+#pragma omp parallel
+#pragma omp single
+      g8_its = partition3_passes< 0, scanning_kernel >( g8.begin(), g8.end(), classify,
+                                                        omp_get_num_threads() );
+      t1 = clock.now();
+      time7 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      const long lower_count = std::count_if( g6.begin(), g6.end(), classify.lower() );
+      const long upper_count = std::count_if( g6.begin(), g6.end(), classify.upper() );
+      auto partitioned3 = [&]( std::vector<int> &v, const std::pair< std::vector<int>::iterator,
+                                                                      std::vector<int>::iterator > &its )
+      {
+        return its.first - v.begin() == lower_count && its.second - v.begin() == upper_count &&
+               std::is_partitioned( v.begin(), v.end(), classify.lower() ) &&
+               std::is_partitioned( its.first, v.end(), classify.upper() );
+      };
+      if( !partitioned3( g7, g7_its ) || !partitioned3( g8, g8_its ) )
+      {
+        std::cout << " FAILED ( turn: " << i << ", ppartition3 )\n";
+        break;
+      }
+
       __gnu_parallel::sort( g.begin(), g_it );
       __gnu_parallel::sort( g_it, g.end() );
       __gnu_parallel::sort( g2.begin(), g2_it );
       __gnu_parallel::sort( g2_it, g2.end() );
+      __gnu_parallel::sort( g4.begin(), g4_it );
+      __gnu_parallel::sort( g4_it, g4.end() );
 
-      if( !std::equal( g.begin(), g.end(), g2.begin() ) )
+      if( !std::equal( g.begin(), g.end(), g2.begin() ) ||
+          !std::equal( g.begin(), g.end(), g4.begin() ) )
       {
         std::cout << " FAILED ( turn: " << i << " )\n";
         break;
@@ -113,6 +349,11 @@ int main( int argc, char* argv[] )
     }
     std::cout << "__gnu_parallel::partition: " << time0 << " s\n";
     std::cout << "               ppartition: " << time1 << " s\n";
+    std::cout << "  ppartition (branchless): " << time3 << " s\n";
+    std::cout << "        pstable_partition: " << time4 << " s\n";
+    std::cout << "pstable_partition_inplace: " << time5 << " s ( pairs of key and position )\n";
+    std::cout << "              ppartition3: " << time6 << " s ( two pivots, one pass )\n";
+    std::cout << " ppartition3 (two passes): " << time7 << " s\n";
     std::cout << "           std::partition: " << time2 << " s\n\n";
   }
 
@@ -120,7 +361,9 @@ int main( int argc, char* argv[] )
   if( 2 == MODE || 4 == MODE || 6 == MODE || 7 == MODE )
   {
     std::cout << "\nTEST: pquicksort ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
-    time0 = 0; time1 = 0; time2 = 0;
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0; time4 = 0; time5 = 0;
+    // busy share of the threads of the work-stealing scheduler
+    double utilization = 0;
 
     for( int i = 0; i < RUNS; i++ )
     {
@@ -128,6 +371,9 @@ int main( int argc, char* argv[] )
       generateRandomIntVector( s.begin(), s.end() );
       std::vector<int> s2( s );
       std::vector<int> s3( s );
+      std::vector<int> s4( s );
+      std::vector<int> s5( s );
+      std::vector<int> s6( s );
 
       if( !std::equal( s.begin(), s.end(), s2.begin() ) ||
           !std::equal( s.begin(), s.end(), s3.begin() ) )
@@ -138,10 +384,12 @@ int main( int argc, char* argv[] )
       t1 = clock.now();
       time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
 
+      sort_utilization used;
       t0 = clock.now();
-      pquicksort( s2.begin(), s2.end() );
+      pquicksort( s2.begin(), s2.end(), std::less<>(), used );
       t1 = clock.now();
       time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+      utilization += used.ratio() / RUNS;
 
       t0 = clock.now();
       //pquicksort_dual_pivot( s3.begin(), s3.end() );
@@ -149,7 +397,25 @@ int main( int argc, char* argv[] )
       t1 = clock.now();
       time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
 
-      if( !std::equal(s.begin(), s.end(), s2.begin()) )
+      t0 = clock.now();
+      pquicksort< 0, branchless_kernel >( s4.begin(), s4.end() );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort< 0, simd_kernel >( s5.begin(), s5.end() );
+      t1 = clock.now();
+      time4 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      psamplesort( s6.begin(), s6.end() );
+      t1 = clock.now();
+      time5 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      if( !std::equal(s.begin(), s.end(), s2.begin()) ||
+          !std::equal(s.begin(), s.end(), s4.begin()) ||
+          !std::equal(s.begin(), s.end(), s5.begin()) ||
+          !std::equal(s.begin(), s.end(), s6.begin()) )
       {
         std::cout << " FAILED ( turn: " << i << " )\n";
         break;
@@ -157,14 +423,25 @@ int main( int argc, char* argv[] )
 
     }
     std::cout << " __gnu_parallel::sort: " << time0 << " s\n";
-    std::cout << "           pquicksort: " << time1 << " s\n";
+    std::cout << "           pquicksort: " << time1 << " s ( utilization: "
+              << 100 * utilization << " % )\n";
+    std::cout << "pquicksort (branchless): " << time3 << " s\n";
+    std::cout << "      pquicksort (simd): " << time4 << " s\n";
+    std::cout << "            psamplesort: " << time5 << " s\n";
     std::cout << "            std::sort: " << time2 << " s\n\n";
   }
 // TEST pquickselect ///////////////////////////////////////////////////////////
   if( 3 == MODE || 5 == MODE || 6 == MODE || 7 == MODE )
   {
     std::cout << "\nTEST: pquickselect ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
-    time0 = 0; time1 = 0; time2 = 0;
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0; time4 = 0; time5 = 0;
+    time6 = 0; time7 = 0;
+    // partial sort of a small ( heap mode ) and a large prefix
+    const long SMALL_K = std::min( 1000L, SIZE );
+    const long LARGE_K = SIZE / 100;
+    // p50, p90, p99 and p99.9 at once
+    const std::vector<long> QUANTILES = { SIZE / 2, SIZE * 9 / 10, SIZE * 99 / 100,
+                                          SIZE * 999 / 1000 };
 
     for( int i = 0; i < RUNS; i++ )
     {
@@ -172,6 +449,10 @@ int main( int argc, char* argv[] )
       generateRandomIntVector( t.begin(), t.end() );
       std::vector<int> t2( t );
       std::vector<int> t3( t );
+      std::vector<int> t4( t );
+      std::vector<int> t5( t );
+      std::vector<int> t6( t );
+      std::vector<int> t7( t );
 
       int k = i * ( SIZE / RUNS );
 
@@ -194,8 +475,42 @@ int main( int argc, char* argv[] )
       t1 = clock.now();
       time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
 
+      t0 = clock.now();
+      __gnu_parallel::partial_sort( t4.begin(), t4.begin() + SMALL_K, t4.end() );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      ppartial_sort( t5.begin(), t5.begin() + SMALL_K, t5.end() );
+      t1 = clock.now();
+      time4 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      ppartial_sort( t6.begin(), t6.begin() + LARGE_K, t6.end() );
+      t1 = clock.now();
+      time5 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquickselect_multi( t7.begin(), t7.end(), QUANTILES.begin(), QUANTILES.end() );
+      t1 = clock.now();
+      time6 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      bool quantiles_equal = true;
+      for( const long q : QUANTILES )
+      {
+        std::vector<int> t8( t );
+        t0 = clock.now();
+        pquickselect( t8.begin(), t8.begin() + q, t8.end() );
+        t1 = clock.now();
+        time7 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+        if( t8[q] != t7[q] ) quantiles_equal = false;
+      }
+
       if( ( *(t.begin() + k) != *(t2.begin() + k) ) ||
-          ( *(t.begin() + k) != *(t3.begin() + k) ) )
+          ( *(t.begin() + k) != *(t3.begin() + k) ) || !quantiles_equal ||
+          !std::equal( t4.begin(), t4.begin() + SMALL_K, t5.begin() ) ||
+          !std::equal( t4.begin(), t4.begin() + std::min( SMALL_K, LARGE_K ), t6.begin() ) ||
+          !std::is_sorted( t6.begin(), t6.begin() + LARGE_K ) )
       {
         std::cout << " FAILED ( turn: " << i << " )\n";
         break;
@@ -204,7 +519,897 @@ int main( int argc, char* argv[] )
     }
     std::cout << "__gnu_parallel::nth_element: " << time0 << " s\n";
     std::cout << "               pquickselect: " << time1 << " s\n";
-    std::cout << "           std::nth_element: " << time2 << " s\n\n";
+    std::cout << "           std::nth_element: " << time2 << " s\n";
+    std::cout << "  __gnu_parallel::partial_sort ( k = " << SMALL_K << " ): " << time3 << " s\n";
+    std::cout << "                 ppartial_sort ( k = " << SMALL_K << " ): " << time4 << " s\n";
+    std::cout << "                 ppartial_sort ( k = " << LARGE_K << " ): " << time5 << " s\n";
+    std::cout << "  pquickselect_multi ( 4 quantiles ): " << time6 << " s\n";
+    std::cout << "        pquickselect ( 4 quantiles ): " << time7 << " s\n\n";
+  }
+// TEST pradix_sort ////////////////////////////////////////////////////////////
+  if( 8 == MODE )
+  {
+    std::cout << "\nTEST: pradix_sort ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0;
+
+    for( int i = 0; i < RUNS; i++ )
+    {
+      std::vector<int> r( SIZE );
+      generateRandomIntVector( r.begin(), r.end() );
+      std::vector<int> r2( r );
+      std::vector<int> r3( r );
+      std::vector<double> r4( r.begin(), r.end() );
+
+      t0 = clock.now();
+      __gnu_parallel::sort( r.begin(), r.end() );
+      t1 = clock.now();
+      time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( r2.begin(), r2.end() );
+      t1 = clock.now();
+      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pradix_sort( r3.begin(), r3.end() );
+      t1 = clock.now();
+      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pradix_sort( r4.begin(), r4.end() );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      if( !std::equal( r.begin(), r.end(), r2.begin() ) ||
+          !std::equal( r.begin(), r.end(), r3.begin() ) ||
+          !std::equal( r.begin(), r.end(), r4.begin() ) )
+      {
+        std::cout << " FAILED ( turn: " << i << " )\n";
+        break;
+      }
+    }
+    std::cout << "  __gnu_parallel::sort: " << time0 << " s\n";
+    std::cout << "            pquicksort: " << time1 << " s\n";
+    std::cout << "           pradix_sort: " << time2 << " s\n";
+    std::cout << "  pradix_sort (double): " << time3 << " s\n\n";
+  }
+// TEST adversarial inputs /////////////////////////////////////////////////////
+  if( 9 == MODE )
+  {
+    std::cout << "\nTEST: adversarial inputs ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+    // quicksort needs O(n log n) comparisons on every input
+    const double BOUND = 8.0;
+    const double NLOGN = SIZE * std::log2( SIZE > 1 ? SIZE : 2 );
+    bool failed = false;
+
+    for( int input = 0; input < ADVERSARIAL_INPUTS && !failed; ++input )
+    {
+      time0 = 0; time1 = 0; time2 = 0; time3 = 0;
+      double ratio0 = 0, ratio1 = 0;
+      for( int i = 0; i < RUNS && !failed; ++i )
+      {
+        std::vector<int> a( SIZE );
+        generateAdversarialVector( a.begin(), a.end(), input );
+        std::vector<int> a2( a );
+        std::vector<int> a3( a );
+        std::vector<int> a4( a );
+        std::vector<int> a5( a );
+
+        t0 = clock.now();
+        std::sort( a.begin(), a.end() );
+        t1 = clock.now();
+        time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        pquicksort( a2.begin(), a2.end() );
+        t1 = clock.now();
+        time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        pquicksort_dual_pivot( a3.begin(), a3.end() );
+        t1 = clock.now();
+        time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        const long k = i * ( SIZE / RUNS );
+        t0 = clock.now();
+        pquickselect( a4.begin(), a4.begin() + k, a4.end() );
+        t1 = clock.now();
+        time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        std::atomic<long> comparisons( 0 );
+        pquicksort( a5.begin(), a5.end(), CountingLess{ &comparisons } );
+        ratio0 = comparisons / NLOGN;
+
+        generateAdversarialVector( a5.begin(), a5.end(), input );
+        comparisons = 0;
+        pquicksort_dual_pivot( a5.begin(), a5.end(), CountingLess{ &comparisons } );
+        ratio1 = comparisons / NLOGN;
+
+        if( !std::equal( a.begin(), a.end(), a2.begin() ) ||
+            !std::equal( a.begin(), a.end(), a3.begin() ) ||
+            !std::equal( a.begin(), a.end(), a5.begin() ) ||
+            a[k] != a4[k] || ratio0 > BOUND || ratio1 > BOUND )
+        {
+          std::cout << " FAILED ( " << adversarialName( input ) << ", turn: " << i << " )\n";
+          failed = true;
+        }
+      }
+      std::cout << adversarialName( input ) << ":\n";
+      std::cout << "              std::sort: " << time0 << " s\n";
+      std::cout << "             pquicksort: " << time1 << " s ( " << ratio0 << " n log2 n comparisons )\n";
+      std::cout << "  pquicksort_dual_pivot: " << time2 << " s ( " << ratio1 << " n log2 n comparisons )\n";
+      std::cout << "           pquickselect: " << time3 << " s\n";
+    }
+
+    // the adversary decides the comparisons while quicksort runs
+    std::vector<int> val( SIZE, SIZE );
+    std::vector<int> ptr( SIZE );
+    for( long i = 0; i < SIZE; ++i ) ptr[i] = i;
+    int nsolid = 0, candidate = 0;
+    long comparisons = 0;
+    quicksort( ptr.begin(), ptr.end(), Antiqsort{ &val, &nsolid, &candidate, &comparisons } );
+    bool sorted = true;
+    for( long i = 1; i < SIZE; ++i )
+      if( val[ptr[i-1]] > val[ptr[i]] ) sorted = false;
+    std::cout << "McIlroy's adversary: " << comparisons / NLOGN << " n log2 n comparisons\n";
+    if( !sorted || comparisons / NLOGN > BOUND )
+      std::cout << " FAILED ( McIlroy's adversary )\n";
+    std::cout << "\n";
+  }
+// TEST presorted inputs ///////////////////////////////////////////////////////
+  if( 10 == MODE )
+  {
+    std::cout << "\nTEST: presorted inputs ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+    bool failed = false;
+
+    for( int input = 0; input < PRESORTED_INPUTS && !failed; ++input )
+    {
+      time0 = 0; time1 = 0; time2 = 0; time3 = 0;
+      for( int i = 0; i < RUNS && !failed; ++i )
+      {
+        std::vector<int> a( SIZE );
+        generatePresortedVector( a.begin(), a.end(), input );
+        std::vector<int> a2( a );
+        std::vector<int> a3( a );
+        const bool expected = std::is_sorted( a.begin(), a.end() );
+
+        t0 = clock.now();
+        const bool sorted = pis_sorted( a.begin(), a.end() );
+        t1 = clock.now();
+        time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        __gnu_parallel::sort( a.begin(), a.end() );
+        t1 = clock.now();
+        time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        pquicksort( a2.begin(), a2.end() );
+        t1 = clock.now();
+        time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        psamplesort( a3.begin(), a3.end() );
+        t1 = clock.now();
+        time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        if( !std::equal( a.begin(), a.end(), a2.begin() ) ||
+            !std::equal( a.begin(), a.end(), a3.begin() ) ||
+            sorted != expected || !pis_sorted( a2.begin(), a2.end() ) )
+        {
+          std::cout << " FAILED ( " << presortedName( input ) << ", turn: " << i << " )\n";
+          failed = true;
+        }
+      }
+      std::cout << presortedName( input ) << ":\n";
+      std::cout << "  __gnu_parallel::sort: " << time0 << " s\n";
+      std::cout << "            pquicksort: " << time1 << " s\n";
+      std::cout << "           psamplesort: " << time2 << " s\n";
+      std::cout << "            pis_sorted: " << time3 << " s\n";
+    }
+    std::cout << "\n";
+  }
+// TEST latency for small arrays ///////////////////////////////////////////////
+  if( 11 == MODE )
+  {
+    std::cout << "\nTEST: latency per call ( vectorsize = " << SIZE << ", calls = " << RUNS << " )\n";
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0; time4 = 0; time5 = 0;
+    time6 = 0; time7 = 0;
+    // the context is created once for all calls, the second one always uses
+    // its team
+    ppq::context ctx;
+    ppq::context team_ctx( omp_get_max_threads(), 0 );
+    std::vector<int> t( SIZE );
+    generateRandomIntVector( t.begin(), t.end() );
+    std::vector<int> sorted( t );
+    std::sort( sorted.begin(), sorted.end() );
+    const long k = SIZE / 2;
+    auto pred = []( const int x ) { return x < 0; };
+    bool failed = false;
+
+    for( int i = 0; i < RUNS && !failed; i++ )
+    {
+      std::vector<int> a1( t ), a2( t ), a3( t ), a4( t ), a5( t ), a6( t ), a7( t ), a8( t );
+
+      t0 = clock.now();
+      pquicksort( a1.begin(), a1.end() );
+      t1 = clock.now();
+      time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( ctx, a2.begin(), a2.end() );
+      t1 = clock.now();
+      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( team_ctx, a3.begin(), a3.end() );
+      t1 = clock.now();
+      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquickselect( a4.begin(), a4.begin() + k, a4.end() );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquickselect( ctx, a5.begin(), a5.begin() + k, a5.end() );
+      t1 = clock.now();
+      time4 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquickselect( team_ctx, a6.begin(), a6.begin() + k, a6.end() );
+      t1 = clock.now();
+      time5 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      const auto middle1 = ppartition( a7.begin(), a7.end(), pred );
+      t1 = clock.now();
+      time6 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      const auto middle2 = ppartition( ctx, a8.begin(), a8.end(), pred );
+      t1 = clock.now();
+      time7 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      if( !std::equal( sorted.begin(), sorted.end(), a1.begin() ) ||
+          !std::equal( sorted.begin(), sorted.end(), a2.begin() ) ||
+          !std::equal( sorted.begin(), sorted.end(), a3.begin() ) ||
+          a4[k] != sorted[k] || a5[k] != sorted[k] || a6[k] != sorted[k] ||
+          middle1 - a7.begin() != middle2 - a8.begin() ||
+          !std::is_partitioned( a7.begin(), a7.end(), pred ) ||
+          !std::is_partitioned( a8.begin(), a8.end(), pred ) )
+      {
+        std::cout << " FAILED ( turn: " << i << " )\n";
+        failed = true;
+      }
+    }
+    // two threads share one context, their calls have to run one after
+    // another while the scratch space grows between the calls
+    std::atomic<bool> shared_failed( false );
+    auto caller = [&]( const unsigned seed )
+    {
+      std::mt19937 gen( seed );
+      for( int call = 0; call < 2 * RUNS; ++call )
+      {
+        std::vector<int> a( 1 + gen() % ( 2 * SIZE ) );
+        for( auto &x : a ) x = static_cast<int>( gen() % 1000 ) - 500;
+        std::vector<int> b( a );
+        const auto middle = pstable_partition( team_ctx, a.begin(), a.end(), pred );
+        std::stable_partition( b.begin(), b.end(), pred );
+        if( a != b || middle - a.begin() != std::count_if( b.begin(), b.end(), pred ) )
+          shared_failed = true;
+      }
+    };
+    std::thread other( caller, 1u );
+    caller( 2u );
+    other.join();
+    if( shared_failed ) std::cout << " FAILED ( context shared by two threads )\n";
+    // a scope of a context with more threads than the calls ask for, the
+    // calls open their own teams of num threads
+    {
+      ppq::context wide( omp_get_max_threads() + 3, 0 );
+      const ppq::context::scope use( wide );
+      std::vector<int> a1( t ), a2( t ), a3( t ), b( t );
+      std::stable_partition( b.begin(), b.end(), pred );
+      const long trues = std::count_if( t.begin(), t.end(), pred );
+      auto value = []( const long i ) { return static_cast<int>( i % 1000 ); };
+      std::unique_ptr<int[]> f( new int[SIZE] );
+      pfirst_touch( f.get(), f.get() + SIZE, value, 2 );
+      bool touched = true;
+      for( long i = 0; i < SIZE; ++i ) touched = touched && f[i] == value( i );
+      if( pstable_partition( a1.begin(), a1.end(), pred ) - a1.begin() != trues || a1 != b ||
+          pstable_partition_inplace( a2.begin(), a2.end(), pred, 2 ) - a2.begin() != trues ||
+          a2 != b || !touched )
+        std::cout << " FAILED ( scope of a larger context, partitioning )\n";
+      pradix_sort( a3.begin(), a3.end(), radix_identity{}, 2 );
+      if( a3 != sorted ) std::cout << " FAILED ( scope of a larger context, pradix_sort )\n";
+      // heap mode and quickselect mode of ppartial_sort
+      std::vector<int> a4( t ), a5( t ), a6( t );
+      const long few = std::min( 16L, SIZE );
+      ppartial_sort( a4.begin(), a4.begin() + few, a4.end(), std::less<>{}, 2 );
+      ppartial_sort( a5.begin(), a5.begin() + k, a5.end() );
+      const auto top = ptop_k( a6.begin(), a6.end(), k, std::less<>{}, 2 );
+      if( !std::equal( a4.begin(), a4.begin() + few, sorted.begin() ) ||
+          !std::equal( a5.begin(), a5.begin() + k, sorted.begin() ) ||
+          !std::equal( a6.begin(), top, sorted.rbegin() ) )
+        std::cout << " FAILED ( scope of a larger context, ppartial_sort )\n";
+    }
+    // threads of a parallel region with a scope of one context sort arrays
+    // of 4 runs, their run merges must not share the scratch space of the
+    // context
+    std::atomic<bool> merge_failed( false );
+#pragma omp parallel num_threads( 4 )
+    {
+      const ppq::context::scope use( team_ctx );
+      std::mt19937 gen( omp_get_thread_num() + 1 );
+      for( int call = 0; call < RUNS; ++call )
+      {
+        std::vector<int> a( 1 + gen() % ( 2 * SIZE ) );
+        for( auto &x : a ) x = static_cast<int>( gen() % 100000 );
+        for( int r = 0; r < 4; ++r )
+          std::sort( a.begin() + a.size() * r / 4, a.begin() + a.size() * ( r + 1 ) / 4 );
+        std::vector<int> b( a );
+        std::sort( b.begin(), b.end() );
+        pquicksort( a.begin(), a.end() );
+        if( a != b ) merge_failed = true;
+      }
+    }
+    if( merge_failed ) std::cout << " FAILED ( scope inside a parallel region )\n";
+    const double US = 1.0E6 / RUNS;
+    std::cout << "                          pquicksort: " << time0 * US << " us\n";
+    std::cout << "              pquicksort ( context ): " << time1 * US << " us\n";
+    std::cout << "   pquicksort ( context, team only ): " << time2 * US << " us\n";
+    std::cout << "                        pquickselect: " << time3 * US << " us\n";
+    std::cout << "            pquickselect ( context ): " << time4 * US << " us\n";
+    std::cout << " pquickselect ( context, team only ): " << time5 * US << " us\n";
+    std::cout << "                          ppartition: " << time6 * US << " us\n";
+    std::cout << "              ppartition ( context ): " << time7 * US << " us\n\n";
+  }
+// TEST NUMA mode /////////////////////////////////////////////////////////////
+  if( 12 == MODE )
+  {
+    // on a single node the per-node segments, their cleanup and the
+    // exchange between them are tested with 2 and 3 simulated nodes, the
+    // threads are spread over them by number ( arrays of at least 2^18
+    // elements and more than one thread )
+    const numa_topology detected = numa();
+    const std::vector<int> node_counts = ( detected.nodes == 1 ) ? std::vector<int>{ 1, 2, 3 }
+                                                                 : std::vector<int>{ detected.nodes };
+    bool failed = false;
+    for( const int nodes : node_counts )
+    {
+      const bool simulated = nodes != detected.nodes;
+      numa().nodes = nodes;
+      if( simulated ) numa().cpu_node.clear();
+      std::cout << "\nTEST: NUMA ( vectorsize = " << SIZE << ", iterations = " << RUNS
+                << ", nodes = " << numa().nodes << ( simulated ? ", simulated" : "" ) << " )\n";
+      time0 = 0; time1 = 0; time2 = 0; time3 = 0;
+      // a serially initialized vector has all pages on the node of the main
+      // thread, pfirst_touch spreads them over the nodes
+      auto value = []( const long i ) { return static_cast<int>( ( i * 2654435761L ) % 1000003 ); };
+      auto pred = []( const int x ) { return x < 500000; };
+      // reference results of the standard library
+      std::vector<int> sorted( SIZE );
+      for( long k = 0; k < SIZE; ++k ) sorted[k] = value( k );
+      const long trues = std::count_if( sorted.begin(), sorted.end(), pred );
+      std::sort( sorted.begin(), sorted.end() );
+
+      for( int i = 0; i < RUNS && !failed; i++ )
+      {
+        std::vector<int> s1( SIZE ), s2( SIZE );
+        for( long k = 0; k < SIZE; ++k ) s1[k] = s2[k] = value( k );
+        std::unique_ptr<int[]> f1( new int[SIZE] ), f2( new int[SIZE] );
+        pfirst_touch( f1.get(), f1.get() + SIZE, value );
+        pfirst_touch( f2.get(), f2.get() + SIZE, value );
+
+        t0 = clock.now();
+        const auto middle1 = ppartition( s1.begin(), s1.end(), pred );
+        t1 = clock.now();
+        time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        const auto middle2 = ppartition( f1.get(), f1.get() + SIZE, pred );
+        t1 = clock.now();
+        time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        pquicksort( s2.begin(), s2.end() );
+        t1 = clock.now();
+        time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        pquicksort( f2.get(), f2.get() + SIZE );
+        t1 = clock.now();
+        time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        if( middle1 - s1.begin() != trues || middle2 - f1.get() != trues ||
+            !std::is_partitioned( s1.begin(), s1.end(), pred ) ||
+            !std::is_partitioned( f1.get(), f1.get() + SIZE, pred ) ||
+            s2 != sorted || !std::equal( sorted.begin(), sorted.end(), f2.get() ) )
+        {
+          std::cout << " FAILED ( turn: " << i << " )\n";
+          failed = true;
+        }
+      }
+      std::cout << "   ppartition ( serial init ): " << time0 << " s\n";
+      std::cout << "  ppartition ( pfirst_touch ): " << time1 << " s\n";
+      std::cout << "   pquicksort ( serial init ): " << time2 << " s\n";
+      std::cout << "  pquicksort ( pfirst_touch ): " << time3 << " s\n\n";
+    }
+    numa() = detected;
+  }
+// TEST psort_file /////////////////////////////////////////////////////////////
+  if( 13 == MODE )
+  {
+    std::cout << "\nTEST: psort_file ( records = " << SIZE << ", iterations = " << RUNS << " )\n";
+    time0 = 0; time1 = 0; time2 = 0;
+    // records of 16 bytes, the first 8 bytes are the key
+    const std::string path = "psort_file_test.bin";
+    const std::size_t record_size = 16;
+    auto key = []( const char *record )
+    {
+      long k;
+      std::memcpy( &k, record, sizeof( k ) );
+      return k;
+    };
+    bool failed = false;
+
+    for( int i = 0; i < RUNS && !failed; i++ )
+    {
+      // about 16 records per key, the payload is the position in the file
+      std::vector<long> f( 2 * SIZE );
+      generateRandomIntVector( f.begin(), f.end() );
+      for( long k = 0; k < SIZE; ++k )
+      {
+        f[2 * k] %= std::max( 1L, SIZE / 16 );
+        f[2 * k + 1] = k;
+      }
+      std::vector<long> g( f );
+
+      t0 = clock.now();
+      __gnu_parallel::stable_sort( reinterpret_cast< std::pair<long, long>* >( g.data() ),
+                                   reinterpret_cast< std::pair<long, long>* >( g.data() ) + SIZE,
+                                   []( const std::pair<long, long> &a, const std::pair<long, long> &b )
+                                   { return a.first < b.first; } );
+      t1 = clock.now();
+      time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      // one run and 8 runs, a chunk needs 5 times its size
+      const std::size_t bytes = SIZE * record_size;
+      for( const std::size_t memory : { 5 * bytes + ( 1 << 20 ), bytes * 5 / 8 } )
+      {
+        {
+          std::ofstream file( path, std::ios::binary );
+          file.write( reinterpret_cast<const char *>( f.data() ), bytes );
+        }
+        t0 = clock.now();
+        psort_file( path, record_size, key, memory );
+        t1 = clock.now();
+        ( memory > bytes ? time1 : time2 ) +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        std::vector<long> h( 2 * SIZE );
+        std::ifstream file( path, std::ios::binary );
+        file.read( reinterpret_cast<char *>( h.data() ), bytes );
+        // sorted by key and stable: the payloads increase within equal keys
+        bool stable = true;
+        for( long k = 1; k < SIZE; ++k )
+          stable = stable && ( h[2 * (k - 1)] < h[2 * k] ||
+                               ( h[2 * (k - 1)] == h[2 * k] && h[2 * k - 1] < h[2 * k + 1] ) );
+        if( !stable || h != g )
+        {
+          std::cout << " FAILED ( turn: " << i << ", memory: " << memory << " )\n";
+          failed = true;
+        }
+      }
+    }
+    std::remove( path.c_str() );
+    std::cout << "  __gnu_parallel::stable_sort ( in memory ): " << time0 << " s\n";
+    std::cout << "                psort_file ( one run ): " << time1 << " s\n";
+    std::cout << "                 psort_file ( 8 runs ): " << time2 << " s\n\n";
+  }
+// TEST pquicksort_by_key and pargsort ////////////////////////////////////////
+  if( 14 == MODE )
+  {
+    std::cout << "\nTEST: pquicksort_by_key ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0;
+    bool failed = false;
+
+    for( int i = 0; i < RUNS && !failed; i++ )
+    {
+      std::vector<int> keys( SIZE );
+      generateRandomIntVector( keys.begin(), keys.end() );
+      std::vector<double> values( SIZE );
+      for( long k = 0; k < SIZE; ++k ) values[k] = 0.5 * keys[k];
+      std::vector<int> k1( keys ), k2( keys );
+      std::vector<double> v1( SIZE ), v2( values );
+
+      // copy to an array of structs, sort and copy back
+      t0 = clock.now();
+      std::vector< std::pair<int, double> > aos( SIZE );
+      for( long k = 0; k < SIZE; ++k ) aos[k] = { k1[k], values[k] };
+      __gnu_parallel::sort( aos.begin(), aos.end(),
+                            []( const std::pair<int, double> &a, const std::pair<int, double> &b )
+                            { return a.first < b.first; } );
+      for( long k = 0; k < SIZE; ++k )
+      {
+        k1[k] = aos[k].first;
+        v1[k] = aos[k].second;
+      }
+      t1 = clock.now();
+      time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort_by_key< 0, branchless_kernel >( k2.begin(), k2.end(), v2.begin() );
+      t1 = clock.now();
+      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      std::vector<long> index1( SIZE );
+      std::iota( index1.begin(), index1.end(), 0L );
+      __gnu_parallel::stable_sort( index1.begin(), index1.end(),
+                                   [&keys]( const long a, const long b ) { return keys[a] < keys[b]; } );
+      t1 = clock.now();
+      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      const std::vector<long> index2 = pargsort< 0, branchless_kernel >( keys.begin(), keys.end() );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      bool values_moved = true;
+      for( long k = 0; k < SIZE; ++k )
+        values_moved = values_moved && v2[k] == 0.5 * k2[k];
+      if( k1 != k2 || !values_moved || index1 != index2 )
+      {
+        std::cout << " FAILED ( turn: " << i << " )\n";
+        failed = true;
+      }
+    }
+    std::cout << "  __gnu_parallel::sort ( array of structs ): " << time0 << " s\n";
+    std::cout << "                      pquicksort_by_key: " << time1 << " s\n";
+    std::cout << "   __gnu_parallel::stable_sort ( indices ): " << time2 << " s\n";
+    std::cout << "                               pargsort: " << time3 << " s\n\n";
+  }
+// TEST execution policies ////////////////////////////////////////////////////
+  if( 15 == MODE )
+  {
+    std::cout << "\nTEST: execution policies ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0; time4 = 0; time5 = 0;
+    ppq::context ctx;
+    bool failed = false;
+    const int half = std::max( 1, omp_get_max_threads() / 2 );
+
+    for( int i = 0; i < RUNS && !failed; i++ )
+    {
+      std::vector<int> t( SIZE );
+      generateRandomIntVector( t.begin(), t.end() );
+      std::vector<int> ref( t );
+      std::sort( ref.begin(), ref.end() );
+      const int pivot = t[0];
+      auto pred = [pivot]( const int x ) { return x < pivot; };
+      const long trues = std::count_if( t.begin(), t.end(), pred );
+      const long nth = SIZE / 3;
+
+      // checks one policy with ppartition and pquickselect
+      auto check = [&]( auto &&policy )
+      {
+        std::vector<int> p( t ), s( t );
+        const auto border = ppartition( policy, p.begin(), p.end(), pred );
+        pquickselect( policy, s.begin(), s.begin() + nth, s.end() );
+        return border - p.begin() == trues && std::is_partitioned( p.begin(), p.end(), pred ) &&
+               s[nth] == ref[nth] &&
+               std::all_of( s.begin(), s.begin() + nth, [&]( const int x ) { return x <= s[nth]; } ) &&
+               std::all_of( s.begin() + nth, s.end(), [&]( const int x ) { return x >= s[nth]; } );
+      };
+      bool ok = check( ppq::par ) && check( ppq::par_unseq ) &&
+                check( ppq::par.with_threads( half ) ) && check( ppq::par_unseq.on( ctx ) ) &&
+                check( ppq::par.with_block_size< 4096 >() );
+
+#if defined( PPQ_STD_EXECUTION )
+      ok = ok && check( std::execution::seq ) && check( std::execution::par ) &&
+           check( std::execution::par_unseq );
+#if defined( __cpp_lib_execution ) && __cpp_lib_execution >= 201902L
+      ok = ok && check( std::execution::unseq );
+#endif
+
+      std::vector<int> a1( t ), a2( t ), a3( t ), a4( t );
+
+      t0 = clock.now();
+      std::sort( std::execution::par, a1.begin(), a1.end() );
+      t1 = clock.now();
+      time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( std::execution::seq, a2.begin(), a2.end() );
+      t1 = clock.now();
+      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( std::execution::par, a3.begin(), a3.end() );
+      t1 = clock.now();
+      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( std::execution::par_unseq, a4.begin(), a4.end() );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      ok = ok && ref == a1 && ref == a2 && ref == a3 && ref == a4;
+#endif
+
+      std::vector<int> a5( t ), a6( t );
+
+      t0 = clock.now();
+      pquicksort( ppq::par.with_threads( half ), a5.begin(), a5.end() );
+      t1 = clock.now();
+      time4 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( ppq::par_unseq.on( ctx ), a6.begin(), a6.end() );
+      t1 = clock.now();
+      time5 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      if( !ok || ref != a5 || ref != a6 )
+      {
+        std::cout << " FAILED ( turn: " << i << " )\n";
+        failed = true;
+      }
+    }
+#if defined( PPQ_STD_EXECUTION )
+    std::cout << "           std::sort ( par ): " << time0 << " s\n";
+    std::cout << "          pquicksort ( seq ): " << time1 << " s\n";
+    std::cout << "          pquicksort ( par ): " << time2 << " s\n";
+    std::cout << "    pquicksort ( par_unseq ): " << time3 << " s\n";
+#else
+    std::cout << " the standard policies need -DPPQ_STD_EXECUTION\n";
+#endif
+    std::cout << " pquicksort ( half threads ): " << time4 << " s\n";
+    std::cout << "  pquicksort ( par_unseq, context ): " << time5 << " s\n\n";
+  }
+
+// TEST statistics /////////////////////////////////////////////////////////////
+  if( 16 == MODE )
+  {
+    std::cout << "\nTEST: statistics ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+#if !defined( PPQ_STATS )
+    std::cout << " the hooks are compiled out, all counters stay zero\n";
+#endif
+    time0 = 0; time1 = 0;
+    ppq::stats partition_stats, sort_stats;
+    bool failed = false;
+
+    for( int i = 0; i < RUNS && !failed; i++ )
+    {
+      std::vector<int> a1( SIZE );
+      generateRandomIntVector( a1.begin(), a1.end() );
+      std::vector<int> a2( a1 );
+      const int pivot = a1[0];
+      auto pred = [pivot]( const int x ) { return x < pivot; };
+
+      t0 = clock.now();
+      {
+        ppq::stats_scope collect( partition_stats );
+        const auto middle = ppartition( a1.begin(), a1.end(), pred );
+        failed = !std::is_partitioned( a1.begin(), a1.end(), pred ) ||
+                 middle != std::partition_point( a1.begin(), a1.end(), pred );
+      }
+      t1 = clock.now();
+      time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      {
+        ppq::stats_scope collect( sort_stats );
+        pquicksort( a2.begin(), a2.end() );
+      }
+      t1 = clock.now();
+      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      failed = failed || !std::is_sorted( a2.begin(), a2.end() );
+      if( failed ) std::cout << " FAILED ( turn: " << i << " )\n";
+    }
+    std::cout << "  ppartition: " << time0 << " s\n" << partition_stats.json();
+    std::cout << "  pquicksort: " << time1 << " s\n" << sort_stats.json() << "\n";
+  }
+
+// TEST string sort ////////////////////////////////////////////////////////////
+  if( 17 == MODE )
+  {
+    std::cout << "\nTEST: string sort ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0; time4 = 0; time5 = 0;
+    long allocations[6] = {};
+    bool failed = false;
+
+    for( int i = 0; i < RUNS && !failed; i++ )
+    {
+      // 32 characters, longer than the small string buffer
+      std::mt19937 gen( i );
+      std::vector<CountedString> t( SIZE );
+      for( auto &s : t )
+      {
+        s.resize( 32 );
+        for( auto &c : s ) c = 'a' + gen() % 26;
+      }
+      std::vector<CountedString> a1( t ), a2( t ), a3( t ), a4( t ), a5( t ), a6( t );
+
+      auto measure = [&]( double &time, long &count, const std::function<void()> &sort )
+      {
+        const long before = stringAllocations.load();
+        const auto start = clock.now();
+        sort();
+        const auto stop = clock.now();
+        time += std::chrono::duration_cast<std::chrono::nanoseconds>( stop - start ).count()/1.0E9;
+        count += stringAllocations.load() - before;
+      };
+      measure( time0, allocations[0], [&]() { std::sort( a1.begin(), a1.end() ); } );
+      measure( time1, allocations[1], [&]() { __gnu_parallel::sort( a2.begin(), a2.end() ); } );
+      measure( time2, allocations[2], [&]() { pquicksort( a3.begin(), a3.end() ); } );
+      measure( time3, allocations[3], [&]() { pquicksort_dual_pivot( a4.begin(), a4.end() ); } );
+      measure( time4, allocations[4], [&]() { psamplesort( a5.begin(), a5.end() ); } );
+      measure( time5, allocations[5], [&]() { pstring_sort( a6.begin(), a6.end() ); } );
+
+      if( a1 != a2 || a1 != a3 || a1 != a4 || a1 != a5 || a1 != a6 )
+      {
+        std::cout << " FAILED ( turn: " << i << " )\n";
+        failed = true;
+      }
+    }
+    std::cout << "              std::sort: " << time0 << " s, " << allocations[0] << " allocations\n";
+    std::cout << "   __gnu_parallel::sort: " << time1 << " s, " << allocations[1] << " allocations\n";
+    std::cout << "             pquicksort: " << time2 << " s, " << allocations[2] << " allocations\n";
+    std::cout << "  pquicksort_dual_pivot: " << time3 << " s, " << allocations[3] << " allocations\n";
+    std::cout << "            psamplesort: " << time4 << " s, " << allocations[4] << " allocations\n";
+    std::cout << "           pstring_sort: " << time5 << " s, " << allocations[5] << " allocations\n\n";
+  }
+
+// TEST large records //////////////////////////////////////////////////////////
+  if( 18 == MODE )
+  {
+    std::cout << "\nTEST: large records ( vectorsize = " << SIZE << ", iterations = " << RUNS
+              << ", indirect from " << indirect_sort_bytes << " bytes )\n";
+    bool failed = false;
+
+    // SIZE is the number of 64 byte records, larger records are fewer
+    auto records = [&]( auto bytes )
+    {
+      constexpr int Bytes = decltype( bytes )::value;
+      using R = Record< Bytes >;
+      const long n = SIZE * 64 / Bytes;
+      auto by_key = []( const R &a, const R &b ) { return a.key < b.key; };
+      auto key = []( const R &r ) { return r.key; };
+      time0 = 0; time1 = 0; time2 = 0;
+
+      for( int i = 0; i < RUNS && !failed; i++ )
+      {
+        std::vector<int> keys( n );
+        generateRandomIntVector( keys.begin(), keys.end() );
+        std::vector<R> a1( n );
+        for( long k = 0; k < n; ++k )
+        {
+          a1[k].key = keys[k];
+          std::memset( a1[k].payload, keys[k] & 0xff, sizeof( a1[k].payload ) );
+        }
+        std::vector<R> a2( a1 ), a3( a1 );
+
+        t0 = clock.now();
+        __gnu_parallel::sort( a1.begin(), a1.end(), by_key );
+        t1 = clock.now();
+        time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        pquicksort( a2.begin(), a2.end(), by_key );
+        t1 = clock.now();
+        time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        t0 = clock.now();
+        pquicksort_by( a3.begin(), a3.end(), key );
+        t1 = clock.now();
+        time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+        // the payload has to move with its key
+        bool moved = true;
+        for( long k = 0; k < n; ++k )
+          moved = moved && a2[k].key == a1[k].key && a3[k].key == a1[k].key &&
+                  a3[k].payload[0] == static_cast<char>( a3[k].key & 0xff ) &&
+                  a3[k].payload[Bytes - 9] == static_cast<char>( a3[k].key & 0xff );
+        if( !moved )
+        {
+          std::cout << " FAILED ( bytes: " << Bytes << ", turn: " << i << " )\n";
+          failed = true;
+        }
+      }
+      std::cout << "  " << Bytes << " bytes, " << n << " records"
+                << ( use_indirect_sort< typename std::vector<R>::iterator >() ? ", indirect" : "" ) << "\n";
+      std::cout << "    __gnu_parallel::sort: " << time0 << " s\n";
+      std::cout << "              pquicksort: " << time1 << " s\n";
+      std::cout << "           pquicksort_by: " << time2 << " s\n";
+    };
+    records( std::integral_constant< int, 64 >{} );
+    records( std::integral_constant< int, 128 >{} );
+    records( std::integral_constant< int, 256 >{} );
+    records( std::integral_constant< int, 512 >{} );
+
+    // two threads share one context, the permutation buffer is its scratch
+    // space
+    ppq::context ctx( omp_get_max_threads(), 0 );
+    std::atomic<bool> shared_failed( false );
+    auto caller = [&]( const unsigned seed )
+    {
+      std::mt19937 gen( seed );
+      for( int call = 0; call < 2 * RUNS; ++call )
+      {
+        std::vector< Record<256> > a( 1 + gen() % SIZE );
+        for( auto &r : a )
+        {
+          r.key = gen() % 1000;
+          std::memset( r.payload, static_cast<int>( r.key ), sizeof( r.payload ) );
+        }
+        {
+          const ppq::context::scope use( ctx );
+          pquicksort_by( a.begin(), a.end(), []( const Record<256> &r ) { return r.key; } );
+        }
+        for( std::size_t k = 0; k < a.size(); ++k )
+          if( ( k > 0 && a[k - 1].key > a[k].key ) ||
+              a[k].payload[0] != static_cast<char>( a[k].key ) )
+            shared_failed = true;
+      }
+    };
+    std::thread other( caller, 1u );
+    caller( 2u );
+    other.join();
+    if( shared_failed ) std::cout << " FAILED ( context shared by two threads )\n";
+    std::cout << "\n";
+  }
+
+// TEST strings with shared prefixes ///////////////////////////////////////////
+  if( 19 == MODE )
+  {
+    std::cout << "\nTEST: strings with shared prefixes ( vectorsize = " << SIZE << ", iterations = " << RUNS << " )\n";
+    time0 = 0; time1 = 0; time2 = 0; time3 = 0;
+    bool failed = false;
+    const std::vector<std::string> hosts = { "https://www.example.com/", "https://www.example.org/",
+                                             "https://static.example.com/assets/", "http://example.net/" };
+
+    for( int i = 0; i < RUNS && !failed; i++ )
+    {
+      // URLs: a few hosts, a path of two random levels and a random file name
+      std::mt19937 gen( i );
+      std::vector<std::string> urls( SIZE );
+      for( auto &url : urls )
+        url = hosts[ gen() % hosts.size() ] + "catalog/" + std::to_string( gen() % 1000 ) + "/item-" +
+              std::to_string( gen() % 100000 ) + ".html";
+      std::vector<std::string> a1( urls ), a2( urls ), a3( urls ), a4( urls );
+
+      t0 = clock.now();
+      std::sort( a1.begin(), a1.end() );
+      t1 = clock.now();
+      time0 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      __gnu_parallel::sort( a2.begin(), a2.end() );
+      t1 = clock.now();
+      time1 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pquicksort( a3.begin(), a3.end() );
+      t1 = clock.now();
+      time2 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      t0 = clock.now();
+      pstring_sort( a4.begin(), a4.end() );
+      t1 = clock.now();
+      time3 += std::chrono::duration_cast<std::chrono::nanoseconds>( t1 - t0 ).count()/1.0E9;
+
+      if( a1 != a2 || a1 != a3 || a1 != a4 )
+      {
+        std::cout << " FAILED ( turn: " << i << " )\n";
+        failed = true;
+      }
+    }
+    std::cout << "             std::sort: " << time0 << " s\n";
+    std::cout << "  __gnu_parallel::sort: " << time1 << " s\n";
+    std::cout << "            pquicksort: " << time2 << " s\n";
+    std::cout << "          pstring_sort: " << time3 << " s\n\n";
   }
   return 0;
 }